@@ -0,0 +1,431 @@
+/** micro benchmarks.
+ *
+ * Each benchmark reports the time per call (ns/op), the throughput (items_per_second) and the p50/p99/p999 latency
+ * of a single call, measured on LATENCY_SAMPLES calls timed one by one after the benchmark loop.
+ *
+ * The scaling benchmarks run 1 to SCALING_THREADS threads against one shared logger, and against one logger per thread
+ * writing into the same file. Items per second are aggregated, latencies are averaged over the threads. Each run then
+ * checks the file: a torn, interleaved or missing line makes the program exit with a non zero status.
+ *
+ * ```
+ * ./logger_benchmarks --benchmark_out=2.3.0.json --benchmark_out_format=json
+ * compare.py benchmarks 2.2.7.json 2.3.0.json # see google benchmark's tools
+ * ```
+ */
+#include <logger/cpp-logger.hpp>
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib> // std::abs
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr size_t LATENCY_SAMPLES = 20000; //!< number of calls timed one by one
+constexpr int    SCALING_THREADS = 16;    //!< maximum number of threads of the scaling benchmarks
+
+/** sink that renders messages and drops them: what a call costs without any I/O. */
+class null_sink : public logger::sink {
+public:
+    null_sink() : logger::sink("null", "benchmarks", logger::log_level::info) {
+        // intentional...
+    }
+
+    void write(logger::log_level level, const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        {
+            logger::printf_message msg(fmt, args);
+            emit(level, msg);
+        }
+        va_end(args);
+    }
+
+    void emit(logger::log_level, const logger::message &msg) override {
+        static thread_local logger::buffer rendered;
+        rendered.clear();
+        msg.render(rendered);
+        benchmark::DoNotOptimize(rendered.data());
+    }
+};
+
+/** file sink that renders lines and drops them: what rendering a line costs without any I/O. */
+class rendering_sink : public logger::file_sink {
+public:
+    rendering_sink() : logger::file_sink("rendering", "benchmarks", logger::log_level::info, nullptr) {
+        // intentional...
+    }
+
+protected:
+    void output(logger::log_level, const char *data, size_t) override {
+        benchmark::DoNotOptimize(data);
+    }
+};
+
+/** the former file_sink header: LOGGER_LOG_PATTERN printf'ed for each line (baseline of file_sink_header). */
+class printf_header_sink : public rendering_sink {
+public:
+    printf_header_sink() : _pattern(std::string(logger::LOGGER_LOG_PATTERN) + "[L SUBSYS=" + name() + "] ") {
+        // intentional...
+    }
+
+protected:
+    void render_line(logger::log_level level, const logger::message &msg, logger::buffer &line) override {
+        char now[logger::DATE_TIME_SIZE];
+        date_time(now, logger::DATE_TIME_SIZE);
+
+        char ecid[logger::ECID_SIZE];
+        this->ecid(ecid, logger::ECID_SIZE);
+
+        line.printf(_pattern.c_str(),
+                    level, now, hostname().c_str(), program_name().c_str(), pid(),
+                    static_cast<int>(pthread_self()), ecid[0] == 0 ? "- " : ecid);
+
+        msg.render(line);
+        line.append('\n');
+    }
+
+private:
+    std::string _pattern; //!< header pattern
+};
+
+/** stand-in syslog daemon: a datagram socket that a thread keeps draining. */
+class syslogd_stub {
+public:
+    syslogd_stub() : _path("/tmp/logger-benchmarks-" + std::to_string(getpid()) + ".sock"), _running(true) {
+        unlink(_path.c_str());
+        _fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, _path.c_str(), sizeof(address.sun_path) - 1);
+        bind(_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+
+        timeval timeout{0, 100000};
+        setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        _reader = std::thread([this]() {
+            char packet[8192];
+            while (_running.load()) {
+                recv(_fd, packet, sizeof(packet), 0);
+            }
+        });
+    }
+
+    ~syslogd_stub() {
+        _running.store(false);
+        _reader.join();
+        close(_fd);
+        unlink(_path.c_str());
+    }
+
+    const std::string &path() const {
+        return _path;
+    }
+
+private:
+    std::string       _path;
+    int               _fd;
+    std::atomic<bool> _running;
+    std::thread       _reader;
+};
+
+/** @return a file in a tmpfs (/dev/shm if available) */
+static std::string tmpfs_path(const char *name) {
+    struct stat info{};
+    std::string directory = stat("/dev/shm", &info) == 0 && S_ISDIR(info.st_mode) ? "/dev/shm" : "/tmp";
+
+    return directory + "/" + name + "-" + std::to_string(getpid()) + ".log";
+}
+
+/** run the benchmark loop, then time LATENCY_SAMPLES calls one by one and report their percentiles.
+ *
+ * @param state benchmark state
+ * @param call logging call to measure
+ */
+template<typename Call> void measure(benchmark::State &state, Call call) {
+    for (auto _ : state) {
+        call();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+
+    // the clock's own cost is measured first, and taken out of each sample
+    std::vector<int64_t> samples(LATENCY_SAMPLES);
+    for (auto &sample : samples) {
+        auto start = std::chrono::steady_clock::now();
+        sample = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+    std::sort(samples.begin(), samples.end());
+    int64_t overhead = samples[samples.size() / 2];
+
+    for (auto &sample : samples) {
+        auto start = std::chrono::steady_clock::now();
+        call();
+        sample = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() - overhead;
+    }
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&samples](double rank) {
+        int64_t value = samples[std::min(samples.size() - 1, static_cast<size_t>(rank * static_cast<double>(samples.size())))];
+        return static_cast<double>(value > 0 ? value : 0);
+    };
+
+    // with more than one thread, these are the average of each thread's percentile
+    state.counters["p50_ns"] = benchmark::Counter(percentile(0.50), benchmark::Counter::kAvgThreads);
+    state.counters["p99_ns"] = benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+    state.counters["p999_ns"] = benchmark::Counter(percentile(0.999), benchmark::Counter::kAvgThreads);
+}
+
+/** the call every benchmark makes (the same as logger_performance_tests) */
+static void log_message(logger::logger &log, long long x) {
+    log.info("Messages #%lld. program: %s, some text %s, %d", x, "performance", "01234567890123456789012345678901234567890123456789", 42);
+}
+
+static void disabled_level(benchmark::State &state) {
+    logger::logger log("disabled", new null_sink());
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log.debug("Messages #%lld. program: %s", x++, "performance");
+    });
+}
+BENCHMARK(disabled_level);
+
+static void null_sink_printf(benchmark::State &state) {
+    logger::logger log("null", new null_sink());
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log_message(log, x++);
+    });
+}
+BENCHMARK(null_sink_printf);
+
+#if __cplusplus >= 201402L
+static void null_sink_format(benchmark::State &state) {
+    logger::logger log("null", new null_sink());
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log.info(LOGGER_FORMAT("Messages #{}. program: {}, some text {}, {}"), x++, "performance", "01234567890123456789012345678901234567890123456789", 42);
+    });
+}
+BENCHMARK(null_sink_format);
+#endif
+
+static void null_sink_fields(benchmark::State &state) {
+    logger::logger log("null", new null_sink());
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        x++;
+        log.info("message", logger::kv("id", x), logger::kv("program", "performance"), logger::kv("answer", 42));
+    });
+}
+BENCHMARK(null_sink_fields);
+
+static void file_sink_dev_null(benchmark::State &state) {
+    FILE *file = fopen("/dev/null", "w");
+    {
+        logger::logger log("file", new logger::file_sink("file", "benchmarks", logger::log_level::info, file));
+        long long x = 0;
+
+        measure(state, [&log, &x]() {
+            log_message(log, x++);
+        });
+    }
+    fclose(file);
+}
+BENCHMARK(file_sink_dev_null);
+
+static void file_sink_header(benchmark::State &state) {
+    logger::logger log("rendering", new rendering_sink());
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log_message(log, x++);
+    });
+}
+BENCHMARK(file_sink_header);
+
+static void file_sink_header_printf(benchmark::State &state) {
+    logger::logger log("rendering", new printf_header_sink());
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log_message(log, x++);
+    });
+}
+BENCHMARK(file_sink_header_printf);
+
+static void file_sink_tmpfs(benchmark::State &state) {
+    std::string path = tmpfs_path("file-sink");
+    FILE *file = fopen(path.c_str(), "w");
+    {
+        logger::logger log("file", new logger::file_sink("file", "benchmarks", logger::log_level::info, file));
+        long long x = 0;
+
+        measure(state, [&log, &x]() {
+            log_message(log, x++);
+        });
+    }
+    fclose(file);
+    unlink(path.c_str());
+}
+BENCHMARK(file_sink_tmpfs);
+
+static void file_sink_tmpfs_buffered(benchmark::State &state) {
+    std::string path = tmpfs_path("file-sink-buffered");
+    FILE *file = fopen(path.c_str(), "w");
+    {
+        logger::logger log("file", new logger::file_sink("file", "benchmarks", logger::log_level::info, file, logger::flush_policy(64, 100)));
+        long long x = 0;
+
+        measure(state, [&log, &x]() {
+            log_message(log, x++);
+        });
+    }
+    fclose(file);
+    unlink(path.c_str());
+}
+BENCHMARK(file_sink_tmpfs_buffered);
+
+static void json_file_sink_dev_null(benchmark::State &state) {
+    FILE *file = fopen("/dev/null", "w");
+    {
+        logger::logger log("json", new logger::json_file_sink("json", "benchmarks", logger::log_level::info, file));
+        long long x = 0;
+
+        measure(state, [&log, &x]() {
+            log_message(log, x++);
+        });
+    }
+    fclose(file);
+}
+BENCHMARK(json_file_sink_dev_null);
+
+static void syslog_sink_local_socket(benchmark::State &state) {
+    syslogd_stub syslogd;
+    logger::logger log("syslog", new logger::syslog_sink("syslog", "benchmarks", logger::log_level::info, logger::syslog::user_facility, 0, syslogd.path()));
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log_message(log, x++);
+    });
+}
+BENCHMARK(syslog_sink_local_socket);
+
+static void syslog_sink_local_socket_batched(benchmark::State &state) {
+    syslogd_stub syslogd;
+    logger::logger log("syslog", new logger::syslog_sink("syslog", "benchmarks", logger::log_level::info, logger::syslog::user_facility, 0, syslogd.path(), 32));
+    long long x = 0;
+
+    measure(state, [&log, &x]() {
+        log_message(log, x++);
+    });
+}
+BENCHMARK(syslog_sink_local_socket_batched);
+
+// scaling ---------------------------------------------------------------
+//
+static const char SCALING_PAYLOAD[] = "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz end";
+
+static std::string            scaling_path;       // file written by the current run
+static FILE                  *scaling_file;
+static logger::logger        *scaling_logger;     // shared logger of the current run
+static std::atomic<long long> scaling_written{0}; // lines written by the current run
+static std::atomic<long long> torn_lines{0};      // bad lines found by all runs
+
+static void scaling_setup(const benchmark::State &) {
+    scaling_path = tmpfs_path("scaling");
+    scaling_file = fopen(scaling_path.c_str(), "w");
+    scaling_logger = new logger::logger("scaling", new logger::file_sink("scaling", "benchmarks", logger::log_level::info, scaling_file));
+    scaling_logger->set_ecid("0123456789012345678901234567890123456789");
+    scaling_written.store(0);
+}
+
+/** check that each line of the file is whole: one header, one payload, one end-of-line */
+static void scaling_teardown(const benchmark::State &state) {
+    delete scaling_logger;
+    for (int index = 0; index < state.threads(); index++) {
+        logger::registry::instance().remove("scaling-" + std::to_string(index));
+    }
+    fclose(scaling_file);
+
+    std::ifstream file(scaling_path);
+    std::string line;
+    long long lines = 0;
+    long long bad = 0;
+
+    while (std::getline(file, line)) {
+        lines++;
+        size_t payload = line.rfind(SCALING_PAYLOAD);
+        if (line.compare(0, 5, "<6>1 ") != 0 || line.find("<6>1 ", 1) != std::string::npos ||
+            payload == std::string::npos || payload + sizeof(SCALING_PAYLOAD) - 1 != line.size() ||
+            line.find(SCALING_PAYLOAD) != payload) {
+            bad++;
+        }
+    }
+
+    bad += std::abs(scaling_written.load() - lines);
+    if (bad > 0) {
+        std::cerr << "ERROR " << state.threads() << " thread(s): " << bad << " torn, interleaved or missing lines out of " << lines << std::endl;
+        torn_lines.fetch_add(bad);
+    }
+
+    unlink(scaling_path.c_str());
+}
+
+static void shared_logger(benchmark::State &state) {
+    int thread = state.thread_index();
+    long long x = 0;
+
+    measure(state, [thread, &x]() {
+        scaling_logger->info("thread %d line %lld %s", thread, x++, SCALING_PAYLOAD);
+    });
+    scaling_written.fetch_add(x);
+}
+BENCHMARK(shared_logger)->Setup(scaling_setup)->Teardown(scaling_teardown)->ThreadRange(1, SCALING_THREADS)->UseRealTime();
+
+static void per_thread_loggers(benchmark::State &state) {
+    int thread = state.thread_index();
+    logger::logger_ptr log = logger::get<logger::file_sink>("scaling-" + std::to_string(thread), scaling_file);
+    log->set_ecid("0123456789012345678901234567890123456789");
+    long long x = 0;
+
+    measure(state, [thread, &log, &x]() {
+        log->info("thread %d line %lld %s", thread, x++, SCALING_PAYLOAD);
+    });
+    scaling_written.fetch_add(x);
+}
+BENCHMARK(per_thread_loggers)->Setup(scaling_setup)->Teardown(scaling_teardown)->ThreadRange(1, SCALING_THREADS)->UseRealTime();
+
+static void registry_get(benchmark::State &state) {
+    logger::logger_ptr expected = logger::get("scaling-lookup");
+
+    measure(state, [&expected]() {
+        logger::logger_ptr found = logger::get("scaling-lookup");
+        benchmark::DoNotOptimize(found.get() == expected.get());
+    });
+}
+BENCHMARK(registry_get)->ThreadRange(1, SCALING_THREADS)->UseRealTime();
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    return torn_lines.load() == 0 ? 0 : 2;
+}
@@ -0,0 +1,343 @@
+/*
+ * logger::async_sink - herbert koelman
+ *
+ * asynchronous sink decorator. Producers push records into a bounded lock-free ring, a background thread drains them
+ * into the decorated sink.
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <memory>   // std::unique_ptr
+#include <cstdarg>  // std::va_list, ...
+#include <cstdint>  // std::intptr_t
+#include <cstring>  // std::memcpy
+#include <type_traits> // std::is_base_of
+
+#ifndef CPP_LOGGER_ASYNC_SINK_HPP
+#define CPP_LOGGER_ASYNC_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+#include <logger/probes.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t ASYNC_SINK_CAPACITY     = 4096; //!< default number of records an async_sink can hold
+    constexpr size_t ASYNC_SINK_MESSAGE_SIZE = 1024; //!< maximum size of a message held by an async_sink (longer messages are truncated)
+
+    /** asynchronous sink decorator.
+     *
+     * Messages are rendered by the calling thread into a slot of a bounded multi-producer/single-consumer ring. A
+     * background thread drains the ring and hands each message to the decorated sink. This way, the caller never pays for
+     * the I/O of the decorated sink.
+     *
+     * When the decorated sink is a file_sink (or one of its subclasses), the calling thread renders the whole line (see
+     * file_sink::render_line()): the timestamp, thread ID and ECID are the caller's, the background thread only hands the
+     * line to the output. Other sinks receive the rendered message from the background thread, their timestamp is the
+     * time it was drained. Lines longer than ASYNC_SINK_MESSAGE_SIZE are truncated (the end-of-line is kept).
+     *
+     * The ring never blocks producers: when it is full, the message is dropped and accounted for (see dropped()).
+     *
+     * ```
+     * auto log = logger::get<logger::async_sink<logger::file_sink>>("async", file);
+     * log->info("this is written by a background thread");
+     * ```
+     *
+     * > **WARN** unless the decorated sink is a file_sink, the sink's ECID is applied when the message is drained.
+     * > Messages that are still in the ring when the ECID changes are written with the new ECID. The calling thread's
+     * > ecid_guard, if any, travels with the message.
+     *
+     * @tparam T decorated sink type
+     * @tparam Capacity number of slots in the ring (MUST be a power of 2)
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    template<class T, size_t Capacity = ASYNC_SINK_CAPACITY> class async_sink : public sink {
+    public:
+
+        static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "async_sink capacity must be a power of 2");
+
+        /** new instance.
+         *
+         * The decorated sink is built with the given arguments, the background thread is started right after.
+         *
+         * @tparam Args decorated sink constructor argument variadic
+         * @param args decorated sink constructor arguments
+         */
+        template<typename... Args> explicit async_sink(const Args&... args) :
+                sink("async-sink", "app", log_levels::info),
+                _sink(args...),
+                _slots(new slot[Capacity]),
+                _enqueue_pos(0),
+                _dequeue_pos(0),
+                _dropped(0),
+                _running(true),
+                _sleeping(false) {
+
+            for (size_t pos = 0; pos < Capacity; pos++) {
+                _slots[pos].sequence.store(pos, std::memory_order_relaxed);
+            }
+
+            // the decorator does the filtering, the decorated sink writes whatever it receives.
+            sink::set_name(_sink.name());
+            sink::set_program_name(_sink.program_name());
+            set_log_level(_sink.level());
+            _sink.set_log_level(log_levels::trace);
+
+            _worker = std::thread(&async_sink::drain, this);
+        }
+
+        /** stop the background thread once all pending messages were written.
+         */
+        ~async_sink() override {
+            _running.store(false);
+            _condition.notify_one();
+
+            if (_worker.joinable()) {
+                _worker.join();
+            }
+        }
+
+        /** \copydoc sink::write()
+         *
+         * The message is rendered by the calling thread and written later by the background thread.
+         */
+        void write(log_level level, const char *fmt, ...) override {
+
+            if (level <= this->level()) {
+                va_list args;
+                va_start(args, fmt);
+                {
+                    printf_message msg(fmt, args);
+                    emit(level, msg);
+                }
+                va_end(args);
+            }
+        }
+
+        /** \copydoc sink::emit()
+         *
+         * The message is rendered by the calling thread and copied in a slot of the ring.
+         */
+        void emit(log_level level, const message &msg) override {
+
+            if (level > this->level()) {
+                return;
+            }
+
+            // render before a slot is claimed, the background thread waits on claimed slots.
+            static thread_local buffer rendered;
+            rendered.clear();
+            render(level, msg, rendered, renders_lines());
+
+            size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+            slot *target = nullptr;
+
+            while (target == nullptr) {
+                slot &candidate = _slots[pos & (Capacity - 1)];
+                size_t sequence = candidate.sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+
+                if (diff == 0) {
+                    if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        target = &candidate;
+                    }
+                } else if (diff < 0) {
+                    // ring is full, we never block the caller.
+                    _dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                } else {
+                    pos = _enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            size_t size = rendered.size() < ASYNC_SINK_MESSAGE_SIZE ? rendered.size() : ASYNC_SINK_MESSAGE_SIZE - 1;
+            memcpy(target->message, rendered.data(), size);
+            if (size < rendered.size() && renders_lines::value) {
+                target->message[size - 1] = '\n'; // truncated line
+            }
+            target->message[size] = 0;
+            target->size = size;
+
+            const ecid_guard *guard = ecid_guard::current();
+            target->scoped_ecid = guard != nullptr;
+            if (guard != nullptr) {
+                memcpy(target->ecid, guard->value(), sizeof(target->ecid));
+            }
+
+            target->level = level;
+            target->sequence.store(pos + 1, std::memory_order_release);
+
+            if (_sleeping.load()) {
+                _condition.notify_one();
+            }
+        }
+
+        /** \copydoc sink::set_ecid()
+         *
+         * The ECID is also forwarded to the decorated sink.
+         */
+        void set_ecid(const std::string &ecid) override {
+            sink::set_ecid(ecid);
+            _sink.set_ecid(ecid);
+        }
+
+        /** wait until every message that was accepted before this call has been handed to the decorated sink.
+         */
+        void flush() {
+            size_t target = _enqueue_pos.load();
+
+            while (_dequeue_pos.load(std::memory_order_acquire) < target) {
+                _condition.notify_one();
+                std::this_thread::yield();
+            }
+        }
+
+        /** @return number of messages that were dropped because the ring was full.
+         */
+        unsigned long long dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+
+        /** \copydoc sink::metrics()
+         *
+         * The decorated sink's counters are added, messages that didn't fit in the ring are counted as dropped.
+         */
+        sink_metrics metrics() override {
+            sink_metrics result = sink::metrics();
+            result += static_cast<sink &>(_sink).metrics();
+            result.dropped += dropped();
+
+            return result;
+        }
+
+        /** @return decorated sink
+         */
+        T &decorated() {
+            return _sink;
+        }
+
+    protected:
+
+        /** set sink name (and decorated sink name).
+         *
+         * @param name subsystem name.
+         */
+        void set_name(const std::string &name) override {
+            sink::set_name(name);
+            static_cast<sink &>(_sink).set_name(name);
+        }
+
+        /** set program name (and decorated sink program name).
+         *
+         * @param name program name.
+         */
+        void set_program_name(const std::string &name) override {
+            sink::set_program_name(name);
+            static_cast<sink &>(_sink).set_program_name(name);
+        }
+
+    private:
+
+        /** a ring slot.
+         *
+         * The sequence tells who owns the slot: when it equals the enqueue position, producers may claim it. When it
+         * equals the enqueue position plus one, it holds a message the consumer can read.
+         */
+        struct slot {
+            std::atomic<size_t> sequence;
+            log_level           level;
+            size_t              size;                   // message size (not counting the terminating \0)
+            bool                scoped_ecid;            // true if the producer had an ecid_guard
+            char                ecid[MAXECIDLEN + 1];   // producer's ecid_guard value
+            char                message[ASYNC_SINK_MESSAGE_SIZE];
+        };
+
+        /** true when the calling thread renders whole lines and the background thread only outputs them */
+        typedef std::integral_constant<bool, std::is_base_of<file_sink, T>::value> renders_lines;
+
+        /** render a file sink's whole line (header, message and end-of-line) */
+        void render(log_level level, const message &msg, buffer &out, std::true_type) {
+            static_cast<file_sink &>(_sink).render_line(level, msg, out);
+            CPP_LOGGER_PROBE(formatted, level, _sink.name().c_str(), out.size());
+        }
+
+        /** render the message only, the decorated sink renders the rest when it's drained */
+        void render(log_level, const message &msg, buffer &out, std::false_type) {
+            msg.render(out);
+        }
+
+        /** hand a rendered line to the decorated file sink's output */
+        void forward(const slot &current, std::true_type) {
+            static_cast<file_sink &>(_sink).output(current.level, current.message, current.size);
+            CPP_LOGGER_PROBE(written, current.level, _sink.name().c_str(), current.size);
+        }
+
+        /** hand a rendered message to the decorated sink */
+        void forward(const slot &current, std::false_type) {
+            if (current.scoped_ecid) {
+                ecid_guard guard(current.ecid); // the producer's thread-scoped ECID
+                _sink.write(current.level, "%s", current.message);
+            } else {
+                _sink.write(current.level, "%s", current.message);
+            }
+        }
+
+        /** background thread body: hand every available message to the decorated sink.
+         */
+        void drain() {
+            size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+
+            for (;;) {
+                slot &current = _slots[pos & (Capacity - 1)];
+
+                if (current.sequence.load(std::memory_order_acquire) == pos + 1) {
+                    forward(current, renders_lines());
+
+                    current.sequence.store(pos + Capacity, std::memory_order_release);
+                    _dequeue_pos.store(++pos, std::memory_order_release);
+
+                } else if (!_running.load() && pos == _enqueue_pos.load()) {
+                    break; // nothing left to drain
+
+                } else {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _sleeping.store(true);
+
+                    // re-check once the flag is visible to producers, they may have published in between.
+                    if (current.sequence.load(std::memory_order_acquire) != pos + 1 && _running.load()) {
+                        _condition.wait_for(lock, std::chrono::milliseconds(10));
+                    }
+
+                    _sleeping.store(false);
+                }
+            }
+        }
+
+        T                        _sink;        //!< decorated sink
+        std::unique_ptr<slot[]>  _slots;       //!< ring of messages
+
+        std::atomic<size_t>      _enqueue_pos; //!< next slot producers will claim
+        char                     _padding[64]; //!< keep producer and consumer positions on separate cache lines
+        std::atomic<size_t>      _dequeue_pos; //!< next slot the background thread will read
+
+        std::atomic<unsigned long long> _dropped; //!< number of messages that didn't fit in the ring
+        std::atomic<bool>        _running;     //!< false when the background thread must stop
+        std::atomic<bool>        _sleeping;    //!< true when the background thread waits for messages
+
+        std::mutex               _mutex;       //!< used to put the background thread asleep
+        std::condition_variable  _condition;   //!< used to wake up the background thread
+        std::thread              _worker;      //!< background thread
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
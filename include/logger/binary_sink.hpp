@@ -0,0 +1,223 @@
+/*
+ * logger::binary_sink - herbert koelman
+ *
+ * deferred formatting: callers store raw argument values, the text is rendered later (offline) by a decoder.
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstdio>   // FILE
+#include <cstdint>  // uint32_t, uint64_t
+
+#ifndef CPP_LOGGER_BINARY_SINK_HPP
+#define CPP_LOGGER_BINARY_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+#include <logger/staging.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr char const *BINARY_LOG_MAGIC = "CPPLOGB1"; //!< first 8 bytes of a binary log file
+    constexpr unsigned int BINARY_SINK_INTERVAL = 10;    //!< drain period of a binary_sink in milliseconds
+
+    /** binary sink (deferred formatting).
+     *
+     * Messages built with LOGGER_FORMAT are not rendered by the caller: the sink only stores a pointer to the call
+     * site's static format descriptor, the raw argument values and a timestamp in the calling thread's staging ring
+     * (see staging_area). A background thread collects the records every BINARY_SINK_INTERVAL milliseconds, orders them
+     * by timestamp and writes them into a binary file. Each format string is written once, the first time it is used.
+     *
+     * Records younger than one drain period are kept for the next drain, so that a record that was staged a bit late
+     * still lands in order. flush() and the destructor write every staged record.
+     *
+     * printf like messages are rendered by the caller and stored as text.
+     *
+     * Binary files are turned into the usual RFC5424 layout by binary_decoder, or by the `cpp-logger-decode` tool:
+     *
+     * ```
+     * auto log = logger::get<logger::binary_sink>("hot-path", file);
+     * log->info(LOGGER_FORMAT("order {} placed in {} us"), order_id, latency);
+     * ...
+     * $ cpp-logger-decode hot-path.bin
+     * ```
+     *
+     * > **WARN** the sink's ECID is sampled by the background thread, records that are still staged when the ECID changes
+     * > are written with the new ECID (the calling thread's ecid_guard, if any, is stored with each record). Binary files use the native byte order, decode them on the same kind of machine.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class binary_sink : public sink {
+    public:
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level (defaults to logger::log_levels::info)
+         * @param file output file (opened in binary mode).
+         */
+        binary_sink(const std::string &name, const std::string &pname, log_level level, FILE *file);
+
+        /** new instance.
+         *
+         * Default initial values:
+         * - name: "binary-sink",
+         * - program_name: "app",
+         * - level: log_level::info
+         *
+         * @param file output file (opened in binary mode).
+         */
+        explicit binary_sink(FILE *file);
+
+        /** stop the background thread once all staged records were written.
+         */
+        ~binary_sink() override;
+
+        /** \copydoc sink::write()
+         *
+         * The message is rendered by the caller and staged as text.
+         */
+        void write(log_level level, const char *fmt, ...) override;
+
+        /** \copydoc sink::emit()
+         *
+         * If the message has a descriptor, only its raw argument values are staged.
+         */
+        void emit(log_level level, const message &msg) override;
+
+        /** write every staged record into the file and flush it.
+         */
+        void flush();
+
+        /** @return number of records that were dropped because a staging ring was full.
+         */
+        unsigned long long dropped();
+
+        /** \copydoc sink::metrics()
+         *
+         * Records dropped because a staging ring was full are counted as dropped.
+         */
+        sink_metrics metrics() override ;
+
+    protected:
+
+        /** \copydoc sink::set_name() */
+        void set_name(const std::string &name) override;
+
+        /** \copydoc sink::set_program_name() */
+        void set_program_name(const std::string &name) override;
+
+    private:
+
+        /** a staged record, as seen by the background thread */
+        struct pending {
+            uint64_t timestamp; //!< nanoseconds since epoch
+            uint64_t thread_id; //!< producer's thread ID
+            size_t   offset;    //!< record offset in _records
+            size_t   size;      //!< record size
+        };
+
+        /** collect staged records and write the ones that are old enough into the file (called by the background thread
+         * and by flush).
+         *
+         * @param everything true to write every record, whatever its age
+         */
+        void drain(bool everything);
+
+        /** background thread body */
+        void run();
+
+        FILE                   *_file;          //!< output file
+        staging_area            _staging;       //!< per-thread staging rings
+
+        std::mutex              _drain_mutex;   //!< serializes drains, protects what follows
+        std::unordered_map<const format_descriptor *, uint32_t> _dictionary; //!< format strings already written
+        std::string             _written_ecid;  //!< last ECID written into the file
+        buffer                  _records[2];    //!< collected records (the active one, and the one that receives records kept for the next drain)
+        int                     _active;        //!< index of the active records buffer
+        std::vector<pending>    _pending;       //!< records collected by a drain (sorted by timestamp)
+        std::vector<pending>    _kept;          //!< records kept for the next drain
+        buffer                  _output;        //!< data written into the file
+
+        std::atomic<bool>       _header_dirty;  //!< true when the header must be (re)written
+        std::atomic<bool>       _running;       //!< false when the background thread must stop
+        std::atomic<bool>       _sleeping;      //!< true when the background thread waits for the next drain
+        std::mutex              _mutex;         //!< used to put the background thread asleep
+        std::condition_variable _condition;     //!< used to wake up the background thread
+        std::thread             _worker;        //!< background thread
+    };
+
+    /** turns binary log files (see binary_sink) back into text.
+     *
+     * Lines use the same layout as file_sink.
+     *
+     * ```
+     * logger::binary_decoder decoder(input);
+     * logger::buffer line;
+     * while (decoder.next(line)) {
+     *     fwrite(line.data(), 1, line.size(), stdout);
+     * }
+     * ```
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class binary_decoder {
+    public:
+
+        /** new instance.
+         *
+         * @param file binary log file
+         * @throws sink_exception if the file is not a binary log file
+         */
+        explicit binary_decoder(FILE *file);
+
+        /** render the next record.
+         *
+         * @param line receives the rendered line (the previous content is cleared)
+         * @return false when the end of the file is reached
+         * @throws sink_exception if the file is corrupted
+         */
+        bool next(buffer &line);
+
+    private:
+
+        /** a format string written by the sink */
+        struct entry {
+            std::string format; //!< format string
+            std::string types;  //!< argument type codes
+        };
+
+        void read(void *target, size_t size);       //!< read exactly size bytes
+        std::string read_string();                  //!< read a length prefixed string
+        void render_header(buffer &line, int level, uint64_t timestamp, uint64_t thread_id);
+        void render_argument(buffer &line, char type);
+
+        FILE                   *_file;     //!< binary log file
+        std::unordered_map<uint32_t, entry> _dictionary; //!< known format strings
+        std::string             _hostname; //!< hostname of the producer
+        std::string             _pname;    //!< program name
+        std::string             _name;     //!< subsystem name
+        std::string             _pattern;  //!< header pattern (see LOGGER_LOG_PATTERN)
+        std::string             _ecid;     //!< current ECID
+        std::string             _scoped_ecid; //!< thread-scoped ECID of the next record
+        bool                    _scoped;   //!< true if the next record has a thread-scoped ECID
+        long                    _offset;   //!< UTC offset of the producer (in seconds)
+        unsigned int            _pid;      //!< process ID of the producer
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
@@ -0,0 +1,133 @@
+/*
+ * logger::buffer - herbert koelman
+ *
+ * growable character buffer used by sinks to render log messages.
+ */
+
+#include <memory>   // std::unique_ptr
+#include <string>   // std::string
+#include <cstdarg>  // std::va_list, ...
+#include <cstddef>  // size_t
+
+#ifndef CPP_LOGGER_BUFFER_HPP
+#define CPP_LOGGER_BUFFER_HPP
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t BUFFER_INITIAL_SIZE = 1024; //!< initial capacity of a message buffer
+
+    /** growable character buffer.
+     *
+     * Sinks render log messages in instances of this class. A buffer only grows, once it's big enough it is reused
+     * without any heap allocation. The content is always terminated by a \0 (which is not counted by size()).
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class buffer {
+    public:
+
+        /** new buffer.
+         *
+         * @param capacity initial capacity (defaults to BUFFER_INITIAL_SIZE)
+         */
+        explicit buffer(size_t capacity = BUFFER_INITIAL_SIZE);
+
+        buffer(const buffer &) = delete;
+        buffer &operator=(const buffer &) = delete;
+
+        /** append characters.
+         *
+         * @param data characters to append
+         * @param size number of characters to append
+         */
+        void append(const char *data, size_t size);
+
+        /** append a string.
+         *
+         * @param data string to append
+         */
+        void append(const std::string &data) {
+            append(data.data(), data.size());
+        }
+
+        /** append a character.
+         *
+         * @param c character to append
+         */
+        void append(char c) {
+            if (_size == _capacity) {
+                reserve(_size + 1);
+            }
+            _data[_size++] = c;
+            _data[_size] = 0;
+        }
+
+        /** append formatted data (see printf for more informations).
+         *
+         * The data is rendered in one pass, unless the buffer needs to grow.
+         *
+         * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data.
+         * @param ... data to print
+         */
+        void printf(const char *fmt, ...);
+
+        /** append formatted data (see vprintf for more informations).
+         *
+         * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data.
+         * @param args data to print
+         */
+        void vprintf(const char *fmt, va_list args);
+
+        /** make sure the buffer can hold capacity characters without any further allocation.
+         *
+         * @param capacity wanted capacity
+         */
+        void reserve(size_t capacity);
+
+        /** empty the buffer (capacity remains untouched).
+         */
+        void clear() {
+            _size = 0;
+            _data[0] = 0;
+        }
+
+        /** @return buffer content (terminated by a \0) */
+        const char *data() const {
+            return _data.get();
+        }
+
+        /** @return number of characters in the buffer */
+        size_t size() const {
+            return _size;
+        }
+
+        /** @return number of characters the buffer can hold without growing */
+        size_t capacity() const {
+            return _capacity;
+        }
+
+        /** @return true if the buffer is empty */
+        bool empty() const {
+            return _size == 0;
+        }
+
+        /** @return last character of the buffer (\0 if the buffer is empty) */
+        char back() const {
+            return _size > 0 ? _data[_size - 1] : 0;
+        }
+
+    private:
+        std::unique_ptr<char[]> _data;     //!< content (one more character is allocated for the terminating \0)
+        size_t                  _size;     //!< number of characters in use
+        size_t                  _capacity; //!< number of characters that can be used
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
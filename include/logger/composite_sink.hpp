@@ -0,0 +1,140 @@
+/*
+ * logger::composite_sink - herbert koelman
+ *
+ * fan-out sink: a message is formatted once and sent to several child sinks.
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef CPP_LOGGER_COMPOSITE_SINK_HPP
+#define CPP_LOGGER_COMPOSITE_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    /** fan-out sink.
+     *
+     * Sends the same messages to several child sinks (i.e. a local file and syslog) with one logger. The message is
+     * rendered once, children receive the rendered text. File sinks that share a layout (see file_sink::layout()) also
+     * share the rendered line: it's rendered by the first one and handed as is to the others' output.
+     *
+     * The composite's level is checked first, then each child's own level. Children take the composite's name, program
+     * name and ECID.
+     *
+     * ```
+     * auto log = logger::get<logger::composite_sink>("orders",
+     *         new logger::file_sink("orders", "shop", logger::log_level::info, file),
+     *         new logger::syslog_sink("orders", "shop", logger::log_level::warning, logger::syslog::local0_facility, LOG_PID));
+     * ```
+     *
+     * > **WARN** children can't be added once the sink is used, composite sinks can't be nested.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class composite_sink : public sink {
+    public:
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level (the children have their own)
+         */
+        composite_sink(const std::string &name, const std::string &pname, log_level level);
+
+        /** new instance, without any child (name: "default", program_name: "pname", level: log_level::trace).
+         */
+        explicit composite_sink();
+
+        /** new instance (name: "default", program_name: "pname", level: log_level::trace).
+         *
+         * @tparam Sinks children types
+         * @param first first child (this instance takes ownership)
+         * @param others other children (this instance takes ownership)
+         */
+        template<typename... Sinks> explicit composite_sink(sink *first, Sinks *... others) : composite_sink() {
+            sink *children[] = {first, others...};
+            for (sink *child : children) {
+                add(child);
+            }
+        }
+
+        /** add a child.
+         *
+         * @param child child sink (this instance takes ownership)
+         * @return this instance
+         * @throw sink_exception if child is null or is a composite_sink
+         */
+        composite_sink &add(sink *child);
+
+        /** @return number of children */
+        size_t size() const {
+            return _children.size();
+        }
+
+        /** write pending lines of children that buffer them (file_sink and syslog_sink).
+         */
+        void flush();
+
+        /** \copydoc sink::write()
+         *
+         * The message is sent to each child.
+         */
+        void write(log_level level, const char *fmt, ...) override ;
+
+        /** \copydoc sink::emit()
+         *
+         * The message is rendered once, then sent to each child which level accepts it.
+         */
+        void emit(log_level level, const message &msg) override ;
+
+        /** change the ECID of this sink and of its children.
+         *
+         * @param ecid new ecid
+         */
+        void set_ecid(const std::string &ecid) override ;
+
+        /** \copydoc sink::metrics()
+         *
+         * The children's counters are added.
+         */
+        sink_metrics metrics() override ;
+
+    protected:
+
+        /** set this sink's name and its children's.
+         *
+         * @param name sink name
+         */
+        void set_name(const std::string &name) override ;
+
+        /** set this sink's program name and its children's.
+         *
+         * @param name program name
+         */
+        void set_program_name(const std::string &name) override ;
+
+    private:
+
+        /** a child sink */
+        struct child {
+            std::unique_ptr<sink> target; //!< child sink
+            file_sink            *file;   //!< the same child if it's a file sink (its lines can be shared), else nullptr
+        };
+
+        std::vector<child> _children; //!< children, file sinks that share a layout are next to each other
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
@@ -1,7 +1,24 @@
 #include <logger/logger.hpp>
 #include <logger/facilities.hpp>
 #include <logger/registry.hpp>
+#include <logger/buffer.hpp>
+#include <logger/thread_info.hpp>
+#include <logger/metrics.hpp>
+#include <logger/probes.hpp>
 #include <logger/sinks.hpp>
+#include <logger/rotating_file_sink.hpp>
+#include <logger/mmap_file_sink.hpp>
+#include <logger/json_sink.hpp>
+#include <logger/composite_sink.hpp>
+#include <logger/uring_writer.hpp>
+#include <logger/staged_sink.hpp>
+#include <logger/rate_limiter.hpp>
+#include <logger/sampling.hpp>
+#include <logger/format.hpp>
+#include <logger/fields.hpp>
+#include <logger/async_sink.hpp>
+#include <logger/staging.hpp>
+#include <logger/binary_sink.hpp>
 #include <logger/exceptions.hpp>
 
 #ifndef CPP_CPP_LOGGER_HPP
@@ -15,6 +15,10 @@
 #ifndef CPP_LOG_DEFINITIONS_HPP
 #define CPP_LOG_DEFINITIONS_HPP
 
+#ifndef CPP_LOGGER_ACTIVE_LEVEL
+#define CPP_LOGGER_ACTIVE_LEVEL 8 // LOG_TRACE, every level is active
+#endif
+
 namespace logger {
 
     /** \addtogroup logger_definitions Type definitions and macros
@@ -32,7 +36,19 @@ namespace logger {
     constexpr short LOG_DEBUG    = 7; //!< debug logging level (see RFC5424)
     constexpr short LOG_TRACE    = 8; //!< trace logging level (see RFC5424)
     constexpr short MAXECIDLEN   = 64;//!< execution ID maximum size/length
+    constexpr size_t DATE_TIME_SIZE = 50;//!< size of a buffer that can hold a message's date and time
+    constexpr size_t ECID_SIZE   = MAXECIDLEN + 12;//!< size of a buffer that can hold a rendered ECID ([M ECID="..."])
     constexpr char const *LOGGER_LOG_PATTERN = "<%d>1 %s %s %s.%d.%d - %-16s";
+    constexpr char const *SYSLOG_PATH = "/dev/log"; //!< syslogd's local socket
+    constexpr char const *SYSLOG_PATTERN = "<%d>1 %s %s %s %s - %s"; //!< RFC5424 header of syslog packets (PRI, time, host, app, procid, ecid)
+    constexpr unsigned int SYSLOG_BATCH_INTERVAL = 100; //!< default time (in milliseconds) batched syslog packets may wait before they're sent
+
+    /** messages which level is above this one are removed at compile time (defaults to LOG_TRACE).
+     *
+     * Set the macro CPP_LOGGER_ACTIVE_LEVEL (i.e. -DCPP_LOGGER_ACTIVE_LEVEL=6) to remove trace and debug calls from
+     * your release builds.
+     */
+    constexpr short ACTIVE_LOG_LEVEL = CPP_LOGGER_ACTIVE_LEVEL;
 
     const     long HOST_NAME_MAX = sysconf(_SC_HOST_NAME_MAX); //!< hostname max size/length
 
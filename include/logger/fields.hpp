@@ -0,0 +1,124 @@
+/*
+ * logger::fields - herbert koelman
+ *
+ * structured key/value fields, rendered as an RFC5424 STRUCTURED-DATA element.
+ */
+
+#include <cstddef>     // size_t
+#include <type_traits> // std::integral_constant, std::is_same
+
+#ifndef CPP_LOGGER_FIELDS_HPP
+#define CPP_LOGGER_FIELDS_HPP
+
+#include <logger/buffer.hpp>
+#include <logger/sinks.hpp>
+#include <logger/format.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t FIELD_NAME_SIZE = 32; //!< maximum size of a field name (RFC5424 SD-NAME)
+
+    /** a key/value pair (see kv()).
+     *
+     * A field only references its key and its value, they're formatted when the message is rendered. Fields are meant
+     * to be built in the logging call's argument list, don't keep them.
+     *
+     * @since v2.3.0
+     */
+    struct field {
+        const char  *key;                                   //!< field name
+        const void  *value;                                 //!< field value
+        void       (*writer)(buffer &out, const void *value); //!< appends the value's text to a buffer (see format_value)
+    };
+
+    //! key/value fields helpers
+    namespace field_details {
+
+        /** append a value (see format_value) */
+        template<typename T> void write(buffer &out, const void *value) {
+            format_value(out, *static_cast<const T *>(value));
+        }
+
+        /** true if at least one of the types is a field */
+        template<typename... Args> struct any_field : std::false_type {};
+
+        template<typename T, typename... Args> struct any_field<T, Args...> :
+                std::integral_constant<bool, std::is_same<T, field>::value || any_field<Args...>::value> {};
+
+        /** true if every type is a field */
+        template<typename... Args> struct all_fields : std::true_type {};
+
+        template<typename T, typename... Args> struct all_fields<T, Args...> :
+                std::integral_constant<bool, std::is_same<T, field>::value && all_fields<Args...>::value> {};
+
+    } // namespace field_details
+
+    /** build a key/value field.
+     *
+     * ```
+     * logger->info("order placed", logger::kv("order_id", id), logger::kv("latency_us", latency));
+     * // ... [L SUBSYS=orders] [F order_id="4242" latency_us="17"] order placed
+     * ```
+     *
+     * Any type that has a format_value() function can be used as a value.
+     *
+     * @tparam T value type
+     * @param key field name (characters that are not allowed in an SD-NAME are replaced by _)
+     * @param value field value (it MUST outlive the logging call)
+     * @return the field
+     * @since v2.3.0
+     */
+    template<typename T> field kv(const char *key, const T &value) {
+        return field{key, &value, &field_details::write<T>};
+    }
+
+    /** message made of free text and key/value fields.
+     *
+     * The fields are rendered as a STRUCTURED-DATA element before the text: `[F key="value" ...] text`. Names are
+     * limited to 32 printable characters, `"`, `\` and `]` are escaped in values (see RFC5424 section 6.3.3). Nothing
+     * is allocated once the calling thread's scratch buffer is big enough.
+     *
+     * @since v2.3.0
+     */
+    class fields_message : public message {
+    public:
+
+        /** new instance.
+         *
+         * @param text message text (printed as is)
+         * @param fields key/value fields (they MUST outlive this instance)
+         * @param count number of fields
+         */
+        fields_message(const char *text, const field *fields, size_t count) :
+                _text(text),
+                _fields(fields),
+                _count(count) {
+            // intentional...
+        }
+
+        /** \copydoc message::render() */
+        void render(buffer &out) const override;
+
+        /** \copydoc message::render_text() */
+        void render_text(buffer &out) const override;
+
+        /** \copydoc message::fields() */
+        const field *fields(size_t &count) const override {
+            count = _count;
+            return _fields;
+        }
+
+    private:
+        const char  *_text;   //!< message text
+        const field *_fields; //!< key/value fields
+        size_t       _count;  //!< number of fields
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
@@ -0,0 +1,430 @@
+/*
+ * logger::format - herbert koelman
+ *
+ * type-safe format strings, parsed at compile time ("order {} placed in {} us").
+ */
+
+#include <string>   // std::string
+#include <cstring>  // std::strlen
+#include <cstddef>  // size_t
+#include <cstdint>  // int64_t, uint64_t, uint32_t
+#include <type_traits>
+
+#ifndef CPP_LOGGER_FORMAT_HPP
+#define CPP_LOGGER_FORMAT_HPP
+
+#include <logger/buffer.hpp>
+#include <logger/sinks.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    /* Value formatters.
+     *
+     * These append the text representation of a value to a buffer. Provide a format_value(buffer &, const your_type &)
+     * function in your type's namespace to print your own types.
+     */
+
+    void format_value(buffer &out, const char *value);         //!< append a string (null pointers are printed as "(null)")
+    void format_value(buffer &out, const std::string &value);  //!< append a string
+    void format_value(buffer &out, char value);                //!< append a character
+    void format_value(buffer &out, bool value);                //!< append true or false
+    void format_value(buffer &out, int value);                 //!< append an integer
+    void format_value(buffer &out, long value);                //!< append an integer
+    void format_value(buffer &out, long long value);           //!< append an integer
+    void format_value(buffer &out, unsigned int value);        //!< append an integer
+    void format_value(buffer &out, unsigned long value);       //!< append an integer
+    void format_value(buffer &out, unsigned long long value);  //!< append an integer
+    void format_value(buffer &out, double value);              //!< append a floating point number (as %g does)
+    void format_value(buffer &out, const void *value);         //!< append a pointer value
+
+    /** @} */
+
+} // namespace logger
+
+// relaxed constexpr functions are needed to parse format strings at compile time.
+#if __cplusplus >= 201402L
+
+/** create a compile-time format string.
+ *
+ * Each `{}` is replaced by the next argument, `{{` and `}}` print `{` and `}`. The string is checked and parsed by the
+ * compiler, an invalid string or a wrong number of arguments are reported as compilation errors.
+ *
+ * ```
+ * logger->info(LOGGER_FORMAT("order {} placed in {} us"), order_id, latency);
+ * ```
+ *
+ * @param str string literal
+ */
+#define LOGGER_FORMAT(str) \
+    ([] { \
+        struct format_string { static constexpr const char *value() { return str; } }; \
+        return ::logger::format<format_string>{}; \
+    }())
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    //! compile-time format string parsing
+    namespace format_details {
+
+        /** a piece of a format string: either literal text or an argument placeholder. */
+        struct segment {
+            size_t begin;    //!< offset of the literal text
+            size_t size;     //!< size of the literal text
+            bool   argument; //!< true if this is an argument placeholder
+        };
+
+        /** parsed format string */
+        template<size_t N> struct segments {
+            segment items[N + 1]; //!< one more, so that empty format strings are handled
+        };
+
+        /** split a format string into segments.
+         *
+         * @param fmt format string
+         * @param items if not null, receives the segments
+         * @return number of segments
+         */
+        constexpr size_t scan(const char *fmt, segment *items) {
+            size_t count = 0;
+            size_t begin = 0;
+            size_t pos = 0;
+
+            while (fmt[pos] != 0) {
+                bool escaped = (fmt[pos] == '{' && fmt[pos + 1] == '{') || (fmt[pos] == '}' && fmt[pos + 1] == '}');
+
+                if (escaped) {
+                    // literal text, up to and including the first brace
+                    if (items != nullptr) {
+                        items[count] = segment{begin, pos + 1 - begin, false};
+                    }
+                    count++;
+                    pos += 2;
+                    begin = pos;
+
+                } else if (fmt[pos] == '{' && fmt[pos + 1] == '}') {
+                    if (pos > begin) {
+                        if (items != nullptr) {
+                            items[count] = segment{begin, pos - begin, false};
+                        }
+                        count++;
+                    }
+                    if (items != nullptr) {
+                        items[count] = segment{pos, 0, true};
+                    }
+                    count++;
+                    pos += 2;
+                    begin = pos;
+
+                } else {
+                    pos++;
+                }
+            }
+
+            if (pos > begin) {
+                if (items != nullptr) {
+                    items[count] = segment{begin, pos - begin, false};
+                }
+                count++;
+            }
+
+            return count;
+        }
+
+        /** @return true if each brace is either escaped or part of a {} placeholder */
+        constexpr bool valid(const char *fmt) {
+            size_t pos = 0;
+
+            while (fmt[pos] != 0) {
+                if ((fmt[pos] == '{' && (fmt[pos + 1] == '{' || fmt[pos + 1] == '}')) || (fmt[pos] == '}' && fmt[pos + 1] == '}')) {
+                    pos += 2;
+                } else if (fmt[pos] == '{' || fmt[pos] == '}') {
+                    return false;
+                } else {
+                    pos++;
+                }
+            }
+
+            return true;
+        }
+
+        /** @return number of {} placeholders */
+        constexpr size_t argument_count(const char *fmt) {
+            size_t count = 0;
+            size_t pos = 0;
+
+            while (fmt[pos] != 0) {
+                if ((fmt[pos] == '{' && fmt[pos + 1] == '{') || (fmt[pos] == '}' && fmt[pos + 1] == '}')) {
+                    pos += 2;
+                } else if (fmt[pos] == '{' && fmt[pos + 1] == '}') {
+                    count++;
+                    pos += 2;
+                } else {
+                    pos++;
+                }
+            }
+
+            return count;
+        }
+
+        /** @return parsed format string */
+        template<size_t N> constexpr segments<N> parse(const char *fmt) {
+            segments<N> result{};
+            scan(fmt, result.items);
+
+            return result;
+        }
+
+        /** append a value's bytes to a buffer */
+        template<typename T> void encode_raw(buffer &out, const T &value) {
+            out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        /** append a string (4 bytes length followed by the characters) to a buffer */
+        inline void encode_string(buffer &out, const char *value, size_t size) {
+            encode_raw(out, static_cast<uint32_t>(size));
+            out.append(value, size);
+        }
+
+        /** binary encoding of an argument (see message::encode).
+         *
+         * Types that have no binary encoding are rendered with format_value and encoded as strings.
+         *
+         * @tparam T argument type
+         */
+        template<typename T, typename Enable = void> struct binary_argument {
+            static constexpr char code = 's'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const T &value) {
+                static thread_local buffer text;
+                text.clear();
+                format_value(text, value);
+                encode_string(out, text.data(), text.size());
+            }
+        };
+
+        /** signed integers are encoded as 8 bytes */
+        template<typename T> struct binary_argument<T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value && !std::is_same<T, char>::value>::type> {
+            static constexpr char code = 'i'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const T &value) {
+                encode_raw(out, static_cast<int64_t>(value));
+            }
+        };
+
+        /** unsigned integers are encoded as 8 bytes */
+        template<typename T> struct binary_argument<T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value && !std::is_same<T, char>::value && !std::is_same<T, bool>::value>::type> {
+            static constexpr char code = 'u'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const T &value) {
+                encode_raw(out, static_cast<uint64_t>(value));
+            }
+        };
+
+        /** floating point numbers are encoded as doubles */
+        template<typename T> struct binary_argument<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+            static constexpr char code = 'd'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const T &value) {
+                encode_raw(out, static_cast<double>(value));
+            }
+        };
+
+        /** characters take one byte */
+        template<> struct binary_argument<char> {
+            static constexpr char code = 'c'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, char value) {
+                out.append(value);
+            }
+        };
+
+        /** booleans take one byte */
+        template<> struct binary_argument<bool> {
+            static constexpr char code = 'b'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, bool value) {
+                out.append(static_cast<char>(value ? 1 : 0));
+            }
+        };
+
+        /** C strings are copied */
+        template<> struct binary_argument<const char *> {
+            static constexpr char code = 's'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const char *value) {
+                if (value == nullptr) {
+                    value = "(null)";
+                }
+                encode_string(out, value, strlen(value));
+            }
+        };
+
+        /** C strings are copied */
+        template<> struct binary_argument<char *> : binary_argument<const char *> {
+        };
+
+        /** character arrays (string literals) are copied */
+        template<size_t N> struct binary_argument<char[N]> : binary_argument<const char *> {
+        };
+
+        /** strings are copied */
+        template<> struct binary_argument<std::string> {
+            static constexpr char code = 's'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const std::string &value) {
+                encode_string(out, value.data(), value.size());
+            }
+        };
+
+        /** other pointers are encoded as 8 bytes addresses */
+        template<typename T> struct binary_argument<T *> {
+            static constexpr char code = 'p'; //!< type code (see format_descriptor)
+
+            /** append the value to a buffer */
+            static void encode(buffer &out, const T *value) {
+                encode_raw(out, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+            }
+        };
+    } // namespace format_details
+
+    /** compile-time format string.
+     *
+     * Instances are created with the LOGGER_FORMAT macro. The string is parsed once, by the compiler, into a sequence of
+     * literal text and argument placeholders.
+     *
+     * @tparam S class which static method value() returns the format string
+     * @since v2.3.0
+     */
+    template<class S> class format {
+    public:
+
+        static_assert(format_details::valid(S::value()), "invalid format string, braces must be doubled ({{ or }}) or used as {}");
+
+        /** @return format string */
+        static constexpr const char *string() {
+            return S::value();
+        }
+
+        static constexpr size_t arguments = format_details::argument_count(S::value()); //!< number of {} placeholders
+        static constexpr size_t size = format_details::scan(S::value(), nullptr);      //!< number of segments
+
+        static constexpr format_details::segments<size> segments = format_details::parse<size>(S::value()); //!< parsed format string
+    };
+
+    template<class S> constexpr size_t format<S>::arguments;
+    template<class S> constexpr size_t format<S>::size;
+    template<class S> constexpr format_details::segments<format<S>::size> format<S>::segments;
+
+    /** message built from a compile-time format string.
+     *
+     * Arguments are not copied, they are formatted straight into the sink's buffer when the message is rendered.
+     *
+     * @tparam S format string class (see LOGGER_FORMAT)
+     * @tparam Args variadic of values to print.
+     * @since v2.3.0
+     */
+    template<class S, typename... Args> class format_message : public message {
+    public:
+
+        static_assert(format<S>::arguments == sizeof...(Args), "the number of arguments doesn't match the number of {} in the format string");
+
+        /** new instance.
+         *
+         * @param args values to print (they MUST outlive this instance)
+         */
+        explicit format_message(const Args&... args) :
+                _values{static_cast<const void *>(&args)..., nullptr},
+                _writers{&format_message::write_argument<Args>..., nullptr} {
+            // intentional...
+        }
+
+        /** \copydoc message::descriptor() */
+        const format_descriptor *descriptor() const override {
+            return &_descriptor;
+        }
+
+        /** \copydoc message::encode() */
+        void encode(buffer &out) const override {
+            for (size_t argument = 0; argument < sizeof...(Args); argument++) {
+                _encoders[argument](out, _values[argument]);
+            }
+        }
+
+        /** \copydoc message::render() */
+        void render(buffer &out) const override {
+            const char *fmt = format<S>::string();
+            size_t argument = 0;
+
+            for (size_t index = 0; index < format<S>::size; index++) {
+                const format_details::segment &current = format<S>::segments.items[index];
+
+                if (current.argument) {
+                    _writers[argument](out, _values[argument]);
+                    argument++;
+                } else {
+                    out.append(fmt + current.begin, current.size);
+                }
+            }
+        }
+
+    private:
+
+        /** append an argument's value to a buffer */
+        template<typename T> static void write_argument(buffer &out, const void *value) {
+            format_value(out, *static_cast<const T *>(value));
+        }
+
+        /** append an argument's binary encoding to a buffer */
+        template<typename T> static void encode_argument(buffer &out, const void *value) {
+            format_details::binary_argument<T>::encode(out, *static_cast<const T *>(value));
+        }
+
+        static const char              _types[sizeof...(Args) + 1];                   //!< argument type codes
+        static const format_descriptor _descriptor;                                   //!< shared by all the messages of a call site
+        static void                  (*const _encoders[sizeof...(Args) + 1])(buffer &, const void *); //!< argument encoders
+
+        const void *_values[sizeof...(Args) + 1];                 //!< arguments
+        void      (*_writers[sizeof...(Args) + 1])(buffer &, const void *); //!< argument formatters
+    };
+
+    template<class S, typename... Args> const char format_message<S, Args...>::_types[sizeof...(Args) + 1] = {format_details::binary_argument<Args>::code..., 0};
+
+    template<class S, typename... Args> const format_descriptor format_message<S, Args...>::_descriptor = {format<S>::string(), format_message<S, Args...>::_types};
+
+    template<class S, typename... Args> void (*const format_message<S, Args...>::_encoders[sizeof...(Args) + 1])(buffer &, const void *) = {&format_message::encode_argument<Args>..., nullptr};
+
+    /** build a message from a compile-time format string.
+     *
+     * @tparam S format string class (see LOGGER_FORMAT)
+     * @tparam Args variadic of values to print.
+     * @param fmt compile-time format string
+     * @param args values to print (they MUST outlive the returned message)
+     * @return message ready to be rendered
+     */
+    template<class S, typename... Args> format_message<S, Args...> make_message(const format<S> &fmt, const Args&... args) {
+        (void) fmt; // only its type matters
+        return format_message<S, Args...>(args...);
+    }
+
+    /** @} */
+
+} // namespace logger
+
+#endif // __cplusplus >= 201402L
+#endif
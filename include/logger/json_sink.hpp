@@ -0,0 +1,123 @@
+/*
+ * logger::json_file_sink - herbert koelman
+ *
+ * file sinks that write one JSON object per line (JSON Lines).
+ */
+
+#include <string>
+
+#ifndef CPP_LOGGER_JSON_SINK_HPP
+#define CPP_LOGGER_JSON_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    /** JSON Lines file sink.
+     *
+     * Each record is rendered as one JSON object per line, in one pass into the calling thread's buffer:
+     *
+     * ```
+     * {"timestamp":"2026-10-18T10:42:01.120034+02:00","level":"info","hostname":"web-1","program":"shop","pid":4242,"tid":4250,"thread":"worker","subsystem":"orders","ecid":"7f3a","message":"order placed","fields":{"order_id":"4242"}}
+     * ```
+     *
+     * tid is the kernel thread ID, thread the thread's name (see current_thread(), omitted if unknown). ecid is null when
+     * no ECID is set. Key/value fields (see kv()) are written as a fields object (values are strings),
+     * the sampling rate of sampled messages as a sampling_rate number. Buffering, flush policies and io backends are the
+     * ones of file_sink.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class json_file_sink : public file_sink {
+    public:
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param file output file.
+         */
+        json_file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file);
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param file output file.
+         * @param policy buffering and flush policy
+         */
+        json_file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file, const flush_policy &policy);
+
+        /** new instance (name: "file-sink", program_name: "app", level: log_level::info).
+         *
+         * @param file output file.
+         */
+        explicit json_file_sink(FILE *file);
+
+        /** new instance.
+         *
+         * @param file output file.
+         * @param policy buffering and flush policy
+         */
+        json_file_sink(FILE *file, const flush_policy &policy);
+
+    protected:
+
+        /** render the record as a JSON object, in one pass.
+         *
+         * \copydetails file_sink::render_line()
+         */
+        void render_line(log_level level, const message &msg, buffer &line) override ;
+
+        /** \copydoc file_sink::layout() */
+        const char *layout() const override {
+            return "json";
+        }
+    };
+
+    /** JSON Lines stdout sink (i.e. for containers).
+     *
+     * ```
+     * auto log = logger::get<logger::json_stdout_sink>("orders");
+     * ```
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class json_stdout_sink : public json_file_sink {
+    public:
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         */
+        json_stdout_sink(const std::string &name, const std::string &pname, log_level level);
+
+        /** new instance.
+         */
+        explicit json_stdout_sink();
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param policy buffering and flush policy
+         */
+        json_stdout_sink(const std::string &name, const std::string &pname, log_level level, const flush_policy &policy);
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
@@ -8,8 +8,16 @@
 #include <cstdlib>
 #include <unistd.h>
 #include <unordered_map> // supposed to be faster
+#include <type_traits>   // std::integral_constant
+#include <atomic>
+#include <cstdint>       // uint64_t
 #include "logger/definitions.hpp"
 #include "logger/sinks.hpp"
+#include "logger/format.hpp"
+#include "logger/fields.hpp"
+#include "logger/rate_limiter.hpp"
+#include "logger/sampling.hpp"
+#include "logger/probes.hpp"
 
 #ifndef CPP_LOGGER_LOGGER_HPP
 #define CPP_LOGGER_LOGGER_HPP
@@ -33,125 +41,216 @@ namespace logger {
        *
        * Messages that contain information normally of use only when debugging a program.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        *
        * @see log handles the actual logging at log_levels::trace.
        */
-      template<typename... Args> void trace( const std::string &fmt, const Args&... args){
-          log(log_levels::trace, fmt, args...);
+      template<typename Format, typename... Args> void trace( const Format &fmt, const Args&... args){
+          log<log_levels::trace>(fmt, args...);
       };
 
       /** Print a debug message.
        *
        * Messages that contain information normally of use only when debugging a program.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::debug.
        */
-      template<typename... Args> void debug( const std::string &fmt, const Args&... args){
-          log(log_levels::debug, fmt, args...);
+      template<typename Format, typename... Args> void debug( const Format &fmt, const Args&... args){
+          log<log_levels::debug>(fmt, args...);
       };
 
       /** Informational messages.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::info.
        */
-      template<typename... Args> void info( const std::string &fmt, const Args&... args){
-          log(log_levels::info, fmt, args...);
+      template<typename Format, typename... Args> void info( const Format &fmt, const Args&... args){
+          log<log_levels::info>(fmt, args...);
       };
 
       /** Normal but significant conditions
        *
        * Conditions that are not error conditions, but that may require special handling.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::notice.
        */
-      template<typename... Args> void notice( const std::string &fmt, const Args&... args){
-          log(log_levels::notice, fmt, args...);
+      template<typename Format, typename... Args> void notice( const Format &fmt, const Args&... args){
+          log<log_levels::notice>(fmt, args...);
       };
 
       /** Warning conditions.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations.
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::warning.
        */
-      template<typename... Args> void warning( const std::string &fmt, const Args&... args){
-          log(log_levels::warning, fmt, args...);
+      template<typename Format, typename... Args> void warning( const Format &fmt, const Args&... args){
+          log<log_levels::warning>(fmt, args...);
       };
 
       /** Error conditions.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::err.
        */
-      template<typename... Args> void err( const std::string &fmt, const Args&... args){
-          log(log_levels::err, fmt, args...);
+      template<typename Format, typename... Args> void err( const Format &fmt, const Args&... args){
+          log<log_levels::err>(fmt, args...);
       };
 
       /** Critical conditions.
        *
        * The system experiences critical conditions like hard device errors.
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::crit.
        */
-      template<typename... Args> void crit( const std::string &fmt, const Args&... args){
-          log(log_levels::crit, fmt, args...);
+      template<typename Format, typename... Args> void crit( const Format &fmt, const Args&... args){
+          log<log_levels::crit>(fmt, args...);
       };
 
       /** Alert conditions.
        *
        * Action must be taken immediately. A condition that should be corrected immediately, such as a corrupted system database.[
        *
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::alert.
        */
-      template<typename... Args> void alert( const std::string &fmt, const Args&... args){
-          log(log_levels::alert, fmt, args...);
+      template<typename Format, typename... Args> void alert( const Format &fmt, const Args&... args){
+          log<log_levels::alert>(fmt, args...);
       };
 
       /** Emergency conditions.
        *
        * System is unusable. A panic condition.
        * 
+       * @tparam Format format string type
        * @tparam Args variadic of values to print.
-       * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
        * @param args data to print.
        * @see log handles the actual logging at log_levels::emerg.
        */
-      template<typename... Args> void emerg( const std::string &fmt, const Args&... args){
-          log(log_levels::emerg, fmt, args...);
+      template<typename Format, typename... Args> void emerg( const Format &fmt, const Args&... args){
+          log<log_levels::emerg>(fmt, args...);
       };
 
       /** log a message if current log level is >= level.
+       *
+       * When the arguments are key/value fields (see kv()), fmt is printed as is and the fields are rendered as a
+       * STRUCTURED-DATA element.
        *
        * @tparam Args variadic of values to print.
        * @param level message logging level
        * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
-       * @param args data to print.
+       * @param args data to print, or key/value fields.
        */
       template<typename... Args> void log( log_level level, const std::string &fmt, const Args&... args){
-        _sink->write(level, fmt.c_str(), args... );
+        CPP_LOGGER_PROBE(log_entry, level, _name.c_str(), 0);
+
+        // the string's address changes from one call to the other, this is never rate limited
+        if ( level <= _sink->level() ) {
+          write(level, nullptr, fmt.c_str(), args...);
+        } else {
+          CPP_LOGGER_PROBE(filtered, level, _name.c_str(), 0);
+          _sink->_metrics.filtered();
+        }
       };
 
+      /** \copydoc log(log_level, const std::string &, const Args&...)
+       *
+       * If a rate limit was set, the call site is identified by the format string's address.
+       */
+      template<typename... Args> void log( log_level level, const char *fmt, const Args&... args){
+        CPP_LOGGER_PROBE(log_entry, level, _name.c_str(), 0);
+
+        if ( level <= _sink->level() ) {
+          write(level, fmt, fmt, args...);
+        } else {
+          CPP_LOGGER_PROBE(filtered, level, _name.c_str(), 0);
+          _sink->_metrics.filtered();
+        }
+      };
+
+      /** log a message if the level is active at compile time and current log level is >= level.
+       *
+       * When Level is above ACTIVE_LOG_LEVEL (see CPP_LOGGER_ACTIVE_LEVEL), the call does nothing and is removed by the
+       * compiler.
+       *
+       * > **WARN** the arguments are still evaluated by the caller (as for any function call), avoid passing
+       * > expressions that have side effects.
+       *
+       * @tparam Level message logging level
+       * @tparam Format format string type
+       * @tparam Args variadic of values to print.
+       * @param fmt printf like format string (see printf for more informations) or compile-time format string (see LOGGER_FORMAT)
+       * @param args data to print.
+       */
+      template<log_level Level, typename Format, typename... Args> void log( const Format &fmt, const Args&... args){
+        log_if(std::integral_constant<bool, (Level <= ACTIVE_LOG_LEVEL)>(), Level, fmt, args...);
+      };
+
+#if __cplusplus >= 201402L
+      /** log a message if current log level is >= level.
+       *
+       * Arguments are type-checked by the compiler and formatted straight into the sink's buffer.
+       *
+       * ```
+       * logger->log(logger::log_level::info, LOGGER_FORMAT("order {} placed in {} us"), order_id, latency);
+       * ```
+       *
+       * @tparam S format string class (see LOGGER_FORMAT)
+       * @tparam Args variadic of values to print.
+       * @param level message logging level
+       * @param fmt compile-time format string
+       * @param args data to print.
+       */
+      template<class S, typename... Args> void log( log_level level, const format<S> &fmt, const Args&... args){
+        CPP_LOGGER_PROBE(log_entry, level, _name.c_str(), 0);
+
+        if ( level <= _sink->level() ) {
+          uint64_t policy = sampling_policy(level);
+          if ( (policy != 0 && !sampling_details::keep(policy, level, this)) || !admit(level, &format<S>::segments) ) {
+            return;
+          }
+
+          uint64_t start = metrics_details::start();
+          if ( policy == 0 ) {
+            _sink->emit(level, make_message(fmt, args...));
+          } else {
+            _sink->emit(level, sampled_message(sampling_details::unpack(policy).rate(), make_message(fmt, args...)));
+          }
+          _sink->_metrics.accepted(start);
+        } else {
+          CPP_LOGGER_PROBE(filtered, level, _name.c_str(), 0);
+          _sink->_metrics.filtered();
+        }
+      };
+#endif
+
       // -------------------------------------------------------------
       //
 
@@ -161,10 +260,68 @@ namespace logger {
        */
       void set_log_level( log_levels level );
 
+      /** change the current log level and the sampling policy of this level.
+       *
+       * ```
+       * logger->set_log_level(logger::log_level::debug, logger::sampling::one_in(1000));
+       * ```
+       *
+       * @param level new logging level
+       * @param policy sampling policy of the level's messages
+       * @since v2.3.0
+       */
+      void set_log_level( log_levels level, const sampling &policy );
+
       /** @return current log level.
        */
       log_levels level() const ;
 
+      /** limit the number of messages each call site may write (log storm suppression).
+       *
+       * A call site is a format string (its address) and a level. Once a call site consumed its burst, its messages are
+       * dropped before being formatted, until its token bucket is refilled. The next message that gets through is
+       * preceded by a summary line (i.e. "suppressed 48213 similar messages in last 10s"). Summaries of call sites that
+       * stopped writing are written by report_suppressed() and when the logger is destroyed.
+       *
+       * ```
+       * logger->set_rate_limit(logger::rate_limit(10, 1)); // 10 messages in a row, then 1 per second and per call site
+       * ```
+       *
+       * @param limit new limit (logger::rate_limit() disables rate limiting)
+       * @since v2.3.0
+       */
+      void set_rate_limit( const rate_limit &limit );
+
+      /** @return number of messages suppressed by the rate limit so far */
+      unsigned long long suppressed() const ;
+
+      /** write the summary of each call site that suppressed messages since its last summary.
+       *
+       * A summary is otherwise written when the call site's next message gets through, which never happens if the
+       * storm stopped.
+       *
+       * @since v2.3.0
+       */
+      void report_suppressed();
+
+      /** write only a fraction of a level's messages.
+       *
+       * The decision is taken before the message is formatted (and before the rate limit is checked). Messages that
+       * are written carry the sampling rate (i.e. `[S RATE="0.001"] `).
+       *
+       * ```
+       * logger->set_sampling(logger::log_level::trace, logger::sampling::percent(0.5));
+       * ```
+       *
+       * @param level level the policy applies to
+       * @param policy sampling policy (logger::sampling() writes every message)
+       * @since v2.3.0
+       */
+      void set_sampling( log_level level, const sampling &policy );
+
+      /** @return the sampling policy of a level */
+      sampling sampling_of( log_level level ) const ;
+
       /** change the current ecid (execution content ID).
        *
        * setting this to an empty string will deactivate the printing of ECIDs.
@@ -183,6 +340,9 @@ namespace logger {
       /** @return logger's program name */
       const std::string &program_name() const;
 
+      /** @return what this logger's sink did so far (see sink::metrics()), named after the logger */
+      sink_metrics metrics();
+
       /** create a logger instance.
        *
        * @param name logger name
@@ -190,9 +350,99 @@ namespace logger {
        */
       logger( const std::string &name, sink *sink);
 
+      /** write the pending suppressed messages summaries (see report_suppressed()) and release the sink.
+       */
+      ~logger();
+
     private:
 
+      /** @return the packed sampling policy of a level (0 means no sampling) */
+      uint64_t sampling_policy( log_level level ) const {
+        return level >= 0 && level <= LOG_TRACE ? _sampling[level].load(std::memory_order_relaxed) : 0;
+      };
+
+      /** sample, check the rate limit and write a printf like message.
+       *
+       * @param site call site (nullptr if the message is never rate limited)
+       */
+      template<typename... Args> void write( log_level level, const void *site, const char *fmt, const Args&... args){
+        uint64_t policy = sampling_policy(level);
+        if ( (policy != 0 && !sampling_details::keep(policy, level, this)) || (site != nullptr && !admit(level, site)) ) {
+          return;
+        }
+
+        uint64_t start = metrics_details::start();
+        write(std::integral_constant<bool, field_details::any_field<Args...>::value>(), level, policy, fmt, args...);
+        _sink->_metrics.accepted(start);
+      };
+
+      /** write a printf like message. */
+      template<typename... Args> void write( std::false_type, log_level level, uint64_t policy, const char *fmt, const Args&... args){
+        if ( policy == 0 ) {
+          _sink->write(level, fmt, args...);
+        } else {
+          write_sampled(level, sampling_details::unpack(policy).rate(), fmt, args...);
+        }
+      };
+
+      /** write a text message followed by key/value fields (see kv()). */
+      template<typename... Args> void write( std::true_type, log_level level, uint64_t policy, const char *text, const Args&... args){
+        static_assert(field_details::all_fields<Args...>::value, "key/value fields can't be mixed with printf arguments");
+
+        const field fields[] = {args...};
+        fields_message msg(text, fields, sizeof...(Args));
+
+        if ( policy == 0 ) {
+          _sink->emit(level, msg);
+        } else {
+          _sink->emit(level, sampled_message(sampling_details::unpack(policy).rate(), msg));
+        }
+      };
+
+      /** write a printf like message that was kept by a sampling policy. */
+      void write_sampled( log_level level, double rate, const char *fmt, ... );
+
+      /** check the call site's rate limit, write the suppressed messages summary if needed.
+       *
+       * @return true if the message must be written
+       */
+      bool admit( log_level level, const void *site ){
+        if ( !_limiter.enabled() ) {
+          return true;
+        }
+
+        unsigned long long suppressed = 0;
+        uint64_t elapsed = 0;
+
+        if ( !_limiter.allow(site, level, suppressed, elapsed) ) {
+          return false;
+        }
+
+        if ( suppressed > 0 ) {
+          write_summary(level, suppressed, elapsed);
+        }
+
+        return true;
+      };
+
+      /** write the suppressed messages summary of a call site. */
+      void write_summary( log_level level, unsigned long long suppressed, uint64_t elapsed );
+
+      /** level is active at compile time, do the actual logging.
+       */
+      template<typename Format, typename... Args> void log_if( std::true_type, log_level level, const Format &fmt, const Args&... args){
+        log(level, fmt, args...);
+      };
+
+      /** level is not active at compile time, do nothing.
+       */
+      template<typename Format, typename... Args> void log_if( std::false_type, log_level, const Format &, const Args&...){
+        // intentional, this is compiled out
+      };
+
       std::unique_ptr<sink>        _sink; //!< logger delegate to a sink the actual magic to write log messages
+      rate_limiter                 _limiter; //!< per call site rate limits (disabled by default)
+      std::atomic<uint64_t>        _sampling[LOG_TRACE + 1]; //!< packed sampling policy of each level (see sampling_details::pack)
 
       std::string _name; //!< logger's name
     }; // logger
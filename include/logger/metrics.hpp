@@ -0,0 +1,185 @@
+/*
+ * logger::metrics - herbert koelman
+ *
+ * what logging costs: per sink counters and write latencies, sharded per thread.
+ */
+
+#include <string>   // std::string
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <atomic>
+#include <chrono>
+
+#ifndef CPP_LOGGER_METRICS_HPP
+#define CPP_LOGGER_METRICS_HPP
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t LATENCY_BUCKETS = 32; //!< number of buckets of the write latency histogram (powers of 2 nanoseconds)
+    constexpr size_t METRICS_SLOTS   = 32; //!< number of threads that count without any atomic read-modify-write
+    constexpr unsigned LATENCY_SAMPLING = 16; //!< one write in LATENCY_SAMPLING is timed (per thread)
+
+    /** snapshot of a sink's metrics.
+     *
+     * Reading the clock costs about as much as formatting a short message, only one write in LATENCY_SAMPLING is timed:
+     * latency[0] counts the timed writes that took no measurable time, latency[i] the ones that took 2^(i-1) to 2^i - 1
+     * nanoseconds (the last bucket also counts the slower ones).
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    struct sink_metrics {
+        std::string        name;      //!< logger (sink) name
+        unsigned long long accepted;  //!< messages handed to the sink (after level, sampling and rate limit checks)
+        unsigned long long filtered;  //!< messages discarded because of their level
+        unsigned long long dropped;   //!< messages lost on the way (i.e. an async_sink's ring was full)
+        unsigned long long bytes;     //!< bytes written
+        unsigned long long errors;    //!< failed writes or flushes (lines, or packets, that may be lost)
+        unsigned long long flushes;   //!< times pending output was handed to the system
+        unsigned long long latency[LATENCY_BUCKETS]; //!< histogram of the time it took to write the timed messages
+
+        sink_metrics();
+
+        /** add another snapshot's counters (i.e. to get the total of all loggers), the name is kept.
+         *
+         * @param other snapshot to add
+         * @return this instance
+         */
+        sink_metrics &operator+=(const sink_metrics &other);
+
+        /** @param rank percentile (i.e. 0.99)
+         * @return upper bound of the write latency percentile in nanoseconds (0 if no message was accepted)
+         */
+        unsigned long long latency_percentile(double rank) const;
+    };
+
+    namespace metrics_details {
+
+        /** @return the calling thread's slot plus one, 0 until its first count */
+        inline unsigned &current_slot() {
+            static thread_local unsigned slot = 0;
+            return slot;
+        }
+
+        /** give the calling thread a slot (METRICS_SLOTS, the shared one, if all are taken).
+         *
+         * @return the calling thread's slot
+         */
+        unsigned acquire_slot();
+
+        /** @return the calling thread's slot */
+        inline unsigned slot() {
+            unsigned slot = current_slot();
+            return slot != 0 ? slot - 1 : acquire_slot();
+        }
+
+        /** @return a monotonic time in nanoseconds */
+        inline uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        /** @return the current time if the calling thread must time this write, else 0 (see LATENCY_SAMPLING) */
+        inline uint64_t start() {
+            static thread_local unsigned writes = 0;
+            return writes++ % LATENCY_SAMPLING == 0 ? now() : 0;
+        }
+
+        /** @return the latency histogram bucket of a duration */
+        inline size_t bucket(uint64_t nanos) {
+            size_t index = 0;
+#if defined(__GNUC__)
+            index = nanos == 0 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(nanos));
+#else
+            for (uint64_t rest = nanos; rest != 0; rest >>= 1) {
+                index++;
+            }
+#endif
+            return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+        }
+    }
+
+    /** a sink's counters.
+     *
+     * Each thread counts in its own shard: the first METRICS_SLOTS threads alive own one and update it with plain
+     * (relaxed) loads and stores, threads beyond that share one last shard and use atomic additions. A snapshot sums up
+     * the shards, it doesn't stop the writers.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class metric_shards {
+    public:
+
+        metric_shards();
+
+        /** count an accepted message and, if it was timed, the time it took to write it.
+         *
+         * @param start what metrics_details::start() returned before the message was written
+         */
+        void accepted(uint64_t start) {
+            add(ACCEPTED, 1);
+            if (start != 0) {
+                add(LATENCY + metrics_details::bucket(metrics_details::now() - start), 1);
+            }
+        }
+
+        /** count a message discarded because of its level */
+        void filtered() {
+            add(FILTERED, 1);
+        }
+
+        /** @param size number of bytes written */
+        void bytes(size_t size) {
+            add(BYTES, size);
+        }
+
+        /** @param count number of failed writes */
+        void errors(size_t count) {
+            add(ERRORS, count);
+        }
+
+        /** count a flush */
+        void flush() {
+            add(FLUSHES, 1);
+        }
+
+        /** add up the shards.
+         *
+         * @param out snapshot to fill (the counters are added to what it already holds)
+         */
+        void collect(sink_metrics &out) const;
+
+    private:
+
+        enum counter : size_t {ACCEPTED, FILTERED, BYTES, ERRORS, FLUSHES, LATENCY};
+
+        static constexpr size_t COUNTERS = LATENCY + LATENCY_BUCKETS; //!< number of counters per shard
+
+        /** counters of one thread (padded to a multiple of a cache line) */
+        struct shard {
+            std::atomic<uint64_t> values[COUNTERS];
+            char                  padding[64 - (COUNTERS * sizeof(uint64_t)) % 64];
+        };
+
+        void add(size_t counter, uint64_t value) {
+            unsigned slot = metrics_details::slot();
+            std::atomic<uint64_t> &target = _shards[slot].values[counter];
+
+            if (slot < METRICS_SLOTS) {
+                target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+            } else {
+                target.fetch_add(value, std::memory_order_relaxed);
+            }
+        }
+
+        shard _shards[METRICS_SLOTS + 1]; //!< one per slot, plus the shared one
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
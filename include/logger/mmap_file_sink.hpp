@@ -0,0 +1,149 @@
+/*
+ * logger::mmap_file_sink - herbert koelman
+ *
+ * file sink that appends lines by copying them into memory-mapped windows of the log file.
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+#ifndef CPP_LOGGER_MMAP_FILE_SINK_HPP
+#define CPP_LOGGER_MMAP_FILE_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t MMAP_SINK_WINDOW_SIZE = 4 * 1024 * 1024; //!< default size of a mapped window (MUST be a multiple of the page size)
+    constexpr size_t MMAP_SINK_WINDOWS     = 4;               //!< number of windows that can be mapped at the same time
+
+    /** memory-mapped append sink.
+     *
+     * Writers reserve room for their line with an atomic fetch-add on the write offset and copy it into a mapped window
+     * of the file: no lock and no system call per line. A background thread maps the next windows before they're needed
+     * and unmaps the old ones. In the rare case a window isn't mapped (yet), the line is written with pwrite, writers
+     * never wait.
+     *
+     * The file grows one window at a time, the unused tail is truncated when the sink is destroyed. If the process
+     * crashes, the lines are in the page cache and reach the file anyway, the zeroed tail is trimmed the next time the file
+     * is opened by a mmap_file_sink.
+     *
+     * ```
+     * auto log = logger::get<logger::mmap_file_sink>("orders", "/var/log/orders.log");
+     * ```
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class mmap_file_sink : public file_sink {
+    public:
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param path log file path (lines are appended)
+         * @param window_size size of a mapped window (rounded up to a multiple of the page size)
+         * @throws sink_exception if the file cannot be opened
+         */
+        mmap_file_sink(const std::string &name, const std::string &pname, log_level level, const std::string &path, size_t window_size = MMAP_SINK_WINDOW_SIZE);
+
+        /** new instance.
+         *
+         * Default initial values:
+         * - name: "mmap-file-sink",
+         * - program_name: "app",
+         * - level: log_level::info
+         *
+         * @param path log file path (lines are appended)
+         * @throws sink_exception if the file cannot be opened
+         */
+        explicit mmap_file_sink(const std::string &path);
+
+        /** stop the background thread, truncate the unused tail and close the file.
+         */
+        ~mmap_file_sink() override;
+
+        /** write the mapped windows back to the disk (msync) and wait for it.
+         */
+        void sync();
+
+        /** @return number of bytes written so far (size of the file once the sink is destroyed) */
+        size_t size() const {
+            return _offset.load(std::memory_order_relaxed);
+        }
+
+        /** @return number of lines, or parts of lines, that were written with pwrite because their window wasn't mapped */
+        unsigned long long fallbacks() const {
+            return _fallbacks.load(std::memory_order_relaxed);
+        }
+
+        /** @return log file path */
+        const std::string &path() const {
+            return _path;
+        }
+
+    protected:
+
+        /** copy the line into the mapped window.
+         *
+         * \copydetails file_sink::output()
+         */
+        void output(log_level, const char *data, size_t size) override;
+
+    private:
+
+        static constexpr size_t UNMAPPED = static_cast<size_t>(-1); //!< index of a window that isn't mapped
+
+        /** a mapped window of the file */
+        struct window {
+            std::atomic<size_t> index;   //!< window index (offset / window size), UNMAPPED if nothing is mapped
+            std::atomic<char *> address; //!< where the window is mapped
+            std::atomic<int>    users;   //!< number of writers currently copying into this window
+        };
+
+        /** copy data into a mapped window.
+         *
+         * @return false if the window isn't mapped
+         */
+        bool copy(size_t index, size_t offset, const char *data, size_t size);
+
+        /** map a window (background thread only) */
+        void map(window &target, size_t index);
+
+        /** unmap a window once no writer uses it (background thread only) */
+        void unmap(window &target);
+
+        /** map the windows writers will soon need, unmap the old ones (background thread only) */
+        void maintain();
+
+        /** background thread body */
+        void run();
+
+        std::string             _path;        //!< log file path
+        int                     _fd;          //!< log file descriptor
+        size_t                  _window_size; //!< size of a window
+        window                  _windows[MMAP_SINK_WINDOWS]; //!< mapped windows (window index modulo MMAP_SINK_WINDOWS)
+
+        std::atomic<size_t>             _offset;    //!< next write offset
+        std::atomic<unsigned long long> _fallbacks; //!< number of pwrite calls
+
+        bool                    _running;   //!< false when the background thread must stop (protected by _mutex)
+        std::mutex              _mutex;     //!< used to put the background thread asleep
+        std::condition_variable _condition; //!< used to wake up the background thread
+        std::thread             _worker;    //!< background thread
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
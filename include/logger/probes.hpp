@@ -0,0 +1,59 @@
+/*
+ * logger::probes - herbert koelman
+ *
+ * USDT (user-level statically defined tracing) probes on the logging hot path, for perf, bpftrace, systemtap...
+ */
+
+#ifndef CPP_LOGGER_PROBES_HPP
+#define CPP_LOGGER_PROBES_HPP
+
+/** \addtogroup logger_log
+ * @{
+ */
+
+/* Probes are compiled in when <sys/sdt.h> is available (i.e. systemtap-sdt-dev on Debian), unless CPP_LOGGER_NO_USDT
+ * is defined (the USDT_PROBES CMake option defines it in the generated logger/config.hpp). A probe that isn't attached
+ * is a nop instruction.
+ *
+ * Provider: cpp_logger. Each probe carries the level, the logger (or sink) name and a byte count:
+ *
+ * | probe     | fired                                                   | byte count               |
+ * |-----------|---------------------------------------------------------|--------------------------|
+ * | log_entry | a logger's log method is called                         | 0                        |
+ * | filtered  | the message is discarded because of its level           | 0                        |
+ * | formatted | a sink rendered the line (or syslog packet)             | rendered size            |
+ * | written   | the line was handed to the output (written or buffered) | rendered size            |
+ *
+ * ```
+ * $ bpftrace -e 'usdt:./program:cpp_logger:written { @bytes[str(arg1)] = sum(arg2); }'
+ * ```
+ */
+#if defined(__has_include)
+#  if __has_include(<logger/config.hpp>)
+#    include <logger/config.hpp>
+#  endif
+#endif
+
+#if !defined(CPP_LOGGER_NO_USDT) && defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#    include <sys/sdt.h>
+#    define CPP_LOGGER_USDT 1 //!< set when the probes are compiled in
+#  endif
+#endif
+
+#ifdef CPP_LOGGER_USDT
+/** fire a USDT probe.
+ *
+ * @param probe probe name (log_entry, filtered, formatted or written)
+ * @param level log level
+ * @param name logger or sink name (const char *)
+ * @param bytes byte count
+ */
+#  define CPP_LOGGER_PROBE(probe, level, name, bytes) DTRACE_PROBE3(cpp_logger, probe, static_cast<int>(level), name, static_cast<unsigned long>(bytes))
+#else
+#  define CPP_LOGGER_PROBE(probe, level, name, bytes) do {} while (false)
+#endif
+
+/** @} */
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * logger::rate_limiter - herbert koelman
+ *
+ * per call site rate limiting (log storm suppression).
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>  // uint64_t, uintptr_t
+#include <ctime>    // clock_gettime
+
+#ifndef CPP_LOGGER_RATE_LIMITER_HPP
+#define CPP_LOGGER_RATE_LIMITER_HPP
+
+#include "logger/definitions.hpp"
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t RATE_LIMITER_SITES  = 1024; //!< number of call sites a rate_limiter can track (MUST be a power of 2)
+    constexpr size_t RATE_LIMITER_PROBES = 16;   //!< number of slots searched for a call site
+
+    /** how many messages a call site may write.
+     *
+     * Each call site (format string and level) gets a token bucket: it may write burst messages in a row, then
+     * per_second messages per second.
+     *
+     * @since v2.3.0
+     */
+    struct rate_limit {
+
+        /** new rate limit.
+         *
+         * @param burst number of messages written in a row before the limit applies (0 disables rate limiting)
+         * @param per_second number of messages per second once the burst is consumed (defaults to 1)
+         */
+        explicit rate_limit(unsigned int burst = 0, double per_second = 1) :
+                burst(burst),
+                per_second(per_second) {
+            // intentional...
+        }
+
+        unsigned int burst;      //!< size of the bucket
+        double       per_second; //!< refill rate
+    };
+
+    /** per call site token buckets.
+     *
+     * Call sites are identified by their format string's address and the message level, they're kept in a fixed size
+     * open addressing table. A check is a couple of atomic operations on the call site's slot: no lock, no allocation,
+     * no formatting. If the table is full, new call sites are not limited.
+     *
+     * The buckets use the generic cell rate algorithm: a slot only keeps the theoretical arrival time of the next
+     * message, a message passes if it isn't more than burst intervals ahead of the clock.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class rate_limiter {
+    public:
+
+        /** new instance (rate limiting is disabled).
+         */
+        rate_limiter();
+
+        /** release the call site table.
+         */
+        ~rate_limiter();
+
+        rate_limiter(const rate_limiter &) = delete;
+        rate_limiter &operator=(const rate_limiter &) = delete;
+
+        /** change the limit (call sites keep their state).
+         *
+         * @param limit new limit (a burst of 0 disables rate limiting)
+         */
+        void set_limit(const rate_limit &limit);
+
+        /** @return true if rate limiting is enabled */
+        bool enabled() const {
+            return _burst_interval.load(std::memory_order_relaxed) != 0;
+        }
+
+        /** check whether a call site may write a message.
+         *
+         * @param site call site's format string address
+         * @param level message level
+         * @param suppressed receives the number of messages suppressed since the last one that passed (only set if the message passes)
+         * @param elapsed receives the time since the first suppressed message in nanoseconds (only set if suppressed > 0)
+         * @return true if the message must be written
+         */
+        bool allow(const void *site, log_level level, unsigned long long &suppressed, uint64_t &elapsed) {
+            slot *target = find(site, level);
+            if (target == nullptr) {
+                return true; // the table is full, don't limit
+            }
+
+            uint64_t current = now();
+            uint64_t interval = _interval.load(std::memory_order_relaxed);
+            uint64_t burst_interval = _burst_interval.load(std::memory_order_relaxed);
+            uint64_t arrival = target->arrival.load(std::memory_order_relaxed);
+
+            for (;;) {
+                uint64_t next = (arrival > current ? arrival : current) + interval;
+
+                if (next - current > burst_interval) {
+                    // first suppressed message of this storm, remember when it started
+                    if (target->suppressed.fetch_add(1, std::memory_order_relaxed) == 0) {
+                        target->since.store(current, std::memory_order_relaxed);
+                    }
+                    return false;
+                }
+
+                if (target->arrival.compare_exchange_weak(arrival, next, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+
+            suppressed = 0;
+            if (target->suppressed.load(std::memory_order_relaxed) != 0) {
+                suppressed = target->suppressed.exchange(0, std::memory_order_relaxed);
+                target->reported.fetch_add(suppressed, std::memory_order_relaxed);
+                elapsed = current - target->since.load(std::memory_order_relaxed);
+            }
+
+            return true;
+        }
+
+        /** hand the suppressed messages of each call site that wasn't summarized yet to a callback (i.e. when a storm
+         * stopped, no message of the call site gets through to carry the summary).
+         *
+         * @tparam Callback void(log_level level, unsigned long long suppressed, uint64_t elapsed)
+         * @param callback called once per call site that suppressed messages since its last summary
+         */
+        template<typename Callback> void drain(Callback callback) {
+            slot *sites = _sites.load(std::memory_order_acquire);
+            if (sites == nullptr) {
+                return;
+            }
+
+            uint64_t current = now();
+            for (size_t index = 0; index < RATE_LIMITER_SITES; index++) {
+                slot &site = sites[index];
+                if (site.suppressed.load(std::memory_order_relaxed) == 0) {
+                    continue;
+                }
+
+                unsigned long long suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+                if (suppressed > 0) {
+                    site.reported.fetch_add(suppressed, std::memory_order_relaxed);
+                    callback(level_of(site.key.load(std::memory_order_relaxed)), suppressed, current - site.since.load(std::memory_order_relaxed));
+                }
+            }
+        }
+
+        /** @return number of messages suppressed so far (all call sites, summed when called) */
+        unsigned long long suppressed() const;
+
+        /** @return monotonic time in nanoseconds (coarse clock when available, it's good enough and much cheaper) */
+        static uint64_t now() {
+#if defined(CLOCK_MONOTONIC_COARSE)
+            timespec current{};
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &current);
+            return static_cast<uint64_t>(current.tv_sec) * 1000000000ULL + static_cast<uint64_t>(current.tv_nsec);
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+    private:
+
+        /** a call site's token bucket */
+        struct slot {
+            std::atomic<uintptr_t> key;        //!< call site key (0 means the slot is free)
+            std::atomic<uint64_t>  arrival;    //!< theoretical arrival time of the next message
+            std::atomic<uint64_t>  suppressed; //!< messages suppressed since the last summary
+            std::atomic<uint64_t>  reported;   //!< messages suppressed before the last summary
+            std::atomic<uint64_t>  since;      //!< time of the first suppressed message
+        };
+
+        /** @return the level a call site key was built with (see find) */
+        static log_level level_of(uintptr_t key) {
+            return static_cast<log_level>(key >> (sizeof(uintptr_t) * 8 - 4));
+        }
+
+        /** @return the call site's slot (it's claimed on first use), nullptr if the table is full */
+        slot *find(const void *site, log_level level) {
+            slot *sites = _sites.load(std::memory_order_acquire);
+            if (sites == nullptr) {
+                return nullptr;
+            }
+
+            // user space addresses leave the top bits free for the level
+            uintptr_t key = reinterpret_cast<uintptr_t>(site) ^ (static_cast<uintptr_t>(level & 0xF) << (sizeof(uintptr_t) * 8 - 4));
+            size_t hash = static_cast<size_t>((key >> 3) * 0x9E3779B97F4A7C15ULL >> 20);
+
+            for (size_t probe = 0; probe < RATE_LIMITER_PROBES; probe++) {
+                slot &candidate = sites[(hash + probe) & (RATE_LIMITER_SITES - 1)];
+                uintptr_t current = candidate.key.load(std::memory_order_relaxed);
+
+                if (current == key) {
+                    return &candidate;
+                }
+                if (current == 0) {
+                    if (candidate.key.compare_exchange_strong(current, key, std::memory_order_relaxed) || current == key) {
+                        return &candidate;
+                    }
+                }
+            }
+
+            return nullptr;
+        }
+
+        std::atomic<slot *>             _sites;          //!< call site table (allocated when a limit is first set)
+        std::atomic<uint64_t>           _interval;       //!< nanoseconds between two messages once the burst is consumed
+        std::atomic<uint64_t>           _burst_interval; //!< burst * interval (0 means rate limiting is disabled)
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
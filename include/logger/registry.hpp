@@ -8,6 +8,9 @@
 #include <cstdlib>
 #include <unistd.h>
 #include <unordered_map>
+#include <vector>
+#include <atomic>
+#include <cstdint> // uint64_t
 
 #include <mutex> // std::mutex
 
@@ -44,12 +47,46 @@ namespace logger {
      */
     void set_level(const log_level level);
 
+    /** Set the current log level of all registered loggers and the sampling policy of this level.
+     *
+     * Default level and sampling policy become these ones.
+     *
+     * @param level wanted log level.
+     * @param policy sampling policy of the level's messages.
+     * @since v2.3.0
+     */
+    void set_level(const log_level level, const sampling &policy);
+
+    /** Set the sampling policy of a level for all registered loggers.
+     *
+     * Loggers created afterwards use this policy too.
+     *
+     * @param level level the policy applies to.
+     * @param policy sampling policy (logger::sampling() writes every message).
+     * @since v2.3.0
+     */
+    void set_sampling(const log_level level, const sampling &policy);
+
     /** set ECID for all registered loggers.
      *
      * @param ecid ECID
      */
     void set_ecid(const std::string &ecid );
 
+    /** metrics of all registered loggers, one snapshot per logger.
+     *
+     * ```
+     * logger::sink_metrics total;
+     * for (auto &current : logger::metrics()) {
+     *     total += current;
+     * }
+     * ```
+     *
+     * @return metrics snapshot of each registered logger (see sink_metrics)
+     * @since v2.3.0
+     */
+    std::vector<sink_metrics> metrics();
+
     /** set program name.
      *
      * *WARN* This name will be used by loggers created after this call. Pre-existing ones are not affected.
@@ -74,6 +111,10 @@ namespace logger {
      * It makes it possible to re-use pre-existing loggers. each logger is indexed by it's name and type (sink). When a
      * multi-threaded programmed needs to log things, sharing a logger between threads might be helpfull.
      *
+     * Lookups don't take any lock once a thread has found a logger: each thread remembers the loggers it already
+     * found. Removing loggers bumps a generation counter which tells threads to forget what they remembered. Creating and
+     * removing loggers still takes a mutex.
+     *
      * @author Herbert Koelman
      */
     class registry {
@@ -104,6 +145,15 @@ namespace logger {
          */
         void set_log_level ( log_level level );
 
+        /** set the sampling policy of a level for all registered loggers
+         *
+         * This policy is also applied to loggers created afterwards.
+         *
+         * @param level log level
+         * @param policy sampling policy
+         */
+        void set_sampling ( log_level level, const sampling &policy );
+
         /**  this is the log level that will be set when a new logger is instanciated.
          *
          * @return registry log level
@@ -128,6 +178,10 @@ namespace logger {
          */
         void set_ecid ( const std::string &ecid );
 
+        /** @return metrics snapshot of each registered logger (see sink::metrics())
+         */
+        std::vector<sink_metrics> metrics();
+
         /** @return a logger instance that uses stdout (if not found a new one is created)
          *
          * @see stdout_sink send messages on stdout.
@@ -145,13 +199,17 @@ namespace logger {
          * @see sink interface between the logger and the target output
          */
         template<class T, typename... Args> logger_ptr get( const std::string &name, const Args&... args){
+          logger_ptr logger = find(name);
+          if ( logger ){
+            return logger; // the calling thread already knows this one
+          }
+
           std::lock_guard<std::mutex> lck(_mutex);
 
 #         ifdef DEBUG
           printf("DEBUG logger::registry.get(%s, %d);\n", name.c_str(), _level);
 #         endif
 
-          logger_ptr logger;
           auto search = _loggers.find(name);
 
           if ( search == _loggers.end() ){
@@ -170,12 +228,18 @@ namespace logger {
               )
             );
 
+            for ( short level = 0; level <= LOG_TRACE; level++ ) {
+              logger->set_sampling(static_cast<log_level>(level), _sampling[level]);
+            }
+
             // register the newly created logger instance
             add(logger);
           } else {
             logger = search->second;
           }
 
+          remember(logger);
+
           return logger;
         };
 
@@ -183,6 +247,19 @@ namespace logger {
 
       private:
 
+        /** search the loggers the calling thread already found (this doesn't take any lock).
+         *
+         * @param name logger instance name
+         * @return the logger instance or an empty pointer if the calling thread doesn't know it (yet)
+         */
+        logger_ptr find(const std::string &name);
+
+        /** remember a logger for the calling thread (MUST be called with _mutex locked).
+         *
+         * @param logger logger instance
+         */
+        void remember(const logger_ptr &logger);
+
         /** register/add a new logger instance
          *
          * **WARN** we don't need to protect the map access beacause it's done by the only method that accesses this one.
@@ -203,7 +280,9 @@ namespace logger {
 #endif
 
         std::mutex     _mutex; //!< used to protect access to static class data
+        std::atomic<uint64_t> _generation; //!< bumped each time loggers are removed (threads then forget what they remembered)
         log_level      _level; //!< used when new logger instances are created by the regsitry
+        sampling       _sampling[LOG_TRACE + 1]; //!< sampling policies used when new logger instances are created
         std::string    _pname;
 
         static std::unique_ptr<registry>       _registry; //!< singleton
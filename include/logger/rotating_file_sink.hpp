@@ -0,0 +1,168 @@
+/*
+ * logger::rotating_file_sink - herbert koelman
+ *
+ * file sink that opens its own files and rotates them on size or time.
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <ctime>    // time_t
+
+#ifndef CPP_LOGGER_ROTATING_FILE_SINK_HPP
+#define CPP_LOGGER_ROTATING_FILE_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    /** when a rotating_file_sink rotates, and how many rotated segments it keeps.
+     *
+     * @since v2.3.0
+     */
+    struct rotation_policy {
+
+        /** new policy.
+         *
+         * @param max_size rotate once the active segment reaches this size in bytes (0 means no size limit, defaults to 10MB)
+         * @param interval rotate every interval seconds (0 means no time limit)
+         * @param retention number of rotated segments to keep (defaults to 5)
+         */
+        explicit rotation_policy(size_t max_size = 10 * 1024 * 1024, unsigned int interval = 0, unsigned int retention = 5) :
+                max_size(max_size),
+                interval(interval),
+                retention(retention) {
+            // intentional...
+        }
+
+        size_t       max_size;  //!< maximum size of a segment in bytes (0 means no size limit)
+        unsigned int interval;  //!< maximum age of a segment in seconds (0 means no time limit)
+        unsigned int retention; //!< number of rotated segments to keep
+    };
+
+    /** rotating file sink.
+     *
+     * The sink opens its own file (path) and rotates it when it's too big or too old: the active segment is renamed
+     * path.1, the previous path.1 becomes path.2 and so on, segments beyond the retention count are deleted.
+     *
+     * Writer threads never wait for the file system: each line is appended to the active segment in one write call. When
+     * the segment is full, the writer only tells the background thread, which swaps in the next segment (it is opened
+     * and pre-allocated in advance, see fallocate), then renames and deletes files.
+     *
+     * ```
+     * auto log = logger::get<logger::rotating_file_sink>("orders", "/var/log/orders.log", logger::rotation_policy(64 * 1024 * 1024, 86400, 7));
+     * ```
+     *
+     * > **WARN** lines written while the background thread is rotating still go to the previous segment, it can slightly
+     * > exceed max_size. The flush_policy of file_sink doesn't apply, lines reach the kernel as soon as they're written.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class rotating_file_sink : public file_sink {
+    public:
+
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param path path of the active segment
+         * @param policy rotation policy
+         * @throws sink_exception if the file cannot be opened
+         */
+        rotating_file_sink(const std::string &name, const std::string &pname, log_level level, const std::string &path, const rotation_policy &policy);
+
+        /** new instance.
+         *
+         * Default initial values:
+         * - name: "rotating-file-sink",
+         * - program_name: "app",
+         * - level: log_level::info
+         *
+         * @param path path of the active segment
+         * @param policy rotation policy
+         * @throws sink_exception if the file cannot be opened
+         */
+        explicit rotating_file_sink(const std::string &path, const rotation_policy &policy = rotation_policy());
+
+        /** stop the background thread and close the files.
+         */
+        ~rotating_file_sink() override;
+
+        /** ask the background thread to rotate now (this doesn't wait for the rotation to happen).
+         */
+        void rotate();
+
+        /** @return number of rotations so far */
+        unsigned long long rotations() const {
+            return _rotations.load(std::memory_order_relaxed);
+        }
+
+        /** @return path of the active segment */
+        const std::string &path() const {
+            return _path;
+        }
+
+    protected:
+
+        /** append the line to the active segment.
+         *
+         * \copydetails file_sink::output()
+         */
+        void output(log_level, const char *data, size_t size) override;
+
+    private:
+
+        /** an open segment */
+        struct segment {
+            int                 fd;      //!< file descriptor
+            std::atomic<size_t> written; //!< number of bytes in the file
+            std::atomic<int>    users;   //!< number of writers currently using this segment
+        };
+
+        /** @return a newly opened segment (nullptr if the file couldn't be opened) */
+        segment *open_segment(const std::string &path, bool truncate);
+
+        /** close a segment once no writer uses it anymore.
+         *
+         * The segment must have been swapped out of _current. Called by the background thread, or by the destructor.
+         */
+        void close_segment(segment *target);
+
+        /** swap in the next segment, rename and delete files (background thread only) */
+        void rotate_now();
+
+        /** background thread body */
+        void run();
+
+        std::string              _path;      //!< path of the active segment
+        std::string              _next_path; //!< path of the pre-allocated segment
+        rotation_policy          _policy;    //!< rotation policy
+
+        std::atomic<segment *>   _current;   //!< active segment
+        segment                 *_next;      //!< pre-allocated segment (background thread only)
+        time_t                   _deadline;  //!< time of the next time based rotation (background thread only)
+
+        std::atomic<bool>               _requested; //!< true when a rotation was requested
+        std::atomic<unsigned long long> _rotations; //!< number of rotations so far
+        std::atomic<unsigned>           _phase;     //!< index of the guard counter writers use
+        std::atomic<int>                _guards[2]; //!< writers between loading _current and counting themselves as users
+
+        bool                    _running;   //!< false when the background thread must stop (protected by _mutex)
+        std::mutex              _mutex;     //!< used to put the background thread asleep
+        std::condition_variable _condition; //!< used to wake up the background thread
+        std::thread             _worker;    //!< background thread
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
@@ -0,0 +1,157 @@
+/*
+ * logger::sampling - herbert koelman
+ *
+ * 1-in-N and probabilistic sampling of log messages.
+ */
+
+#include <chrono>
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+
+#ifndef CPP_LOGGER_SAMPLING_HPP
+#define CPP_LOGGER_SAMPLING_HPP
+
+#include "logger/definitions.hpp"
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    /** which fraction of a level's messages is written.
+     *
+     * ```
+     * logger->set_sampling(logger::log_level::debug, logger::sampling::one_in(1000)); // 1 debug message in 1000
+     * logger->set_sampling(logger::log_level::trace, logger::sampling::percent(0.5)); // 0.5% of trace messages
+     * ```
+     *
+     * A 1-in-N policy keeps a counter per thread, per logger and per level, a probabilistic policy draws a per thread
+     * pseudo random number. Either way, the decision is taken before the message is formatted and doesn't touch any shared state.
+     *
+     * @since v2.3.0
+     */
+    struct sampling {
+
+        /** new instance, every message is written (no sampling).
+         */
+        sampling() : every(1), probability(1) {
+            // intentional...
+        }
+
+        /** @return a policy that writes 1 message in count (count is 0 or 1 means every message) */
+        static sampling one_in(unsigned int count) {
+            sampling policy;
+            policy.every = count > 0 ? count : 1;
+            return policy;
+        }
+
+        /** @return a policy that writes the given percentage of messages (0 to 100) */
+        static sampling percent(double percent) {
+            sampling policy;
+            policy.every = 0;
+            policy.probability = percent <= 0 ? 0 : (percent >= 100 ? 1 : percent / 100);
+            return policy;
+        }
+
+        /** @return fraction of messages that are written (1 means no sampling) */
+        double rate() const {
+            return every > 0 ? 1.0 / every : probability;
+        }
+
+        unsigned int every;       //!< write 1 message in every (0 means the policy is probabilistic)
+        double       probability; //!< probability to write a message (probabilistic policies)
+    };
+
+    /** sampling decisions.
+     *
+     * A policy is packed into a 64 bits word so that loggers can change it atomically: 0 means no sampling, else the
+     * PROBABILISTIC bit tells whether the lower 32 bits are the 1-in-N count or the probability (scaled to 2^32).
+     */
+    namespace sampling_details {
+
+        constexpr uint64_t PROBABILISTIC = 1ULL << 32;  //!< set when the lower bits are a probability
+        constexpr size_t   COUNTED_LOGGERS = 8;         //!< number of loggers a thread keeps 1-in-N counters for
+
+        /** a thread's 1-in-N counters for one logger */
+        struct counters {
+            const void *owner;      //!< logger the counters belong to
+            uint32_t    values[16]; //!< one counter per level
+        };
+
+        /** @return the packed policy */
+        inline uint64_t pack(const sampling &policy) {
+            if (policy.every == 1 || (policy.every == 0 && policy.probability >= 1)) {
+                return 0;
+            }
+            if (policy.every > 1) {
+                return policy.every;
+            }
+
+            auto threshold = static_cast<uint64_t>(policy.probability * 4294967296.0);
+            return PROBABILISTIC | (threshold > 0xFFFFFFFFULL ? 0xFFFFFFFFULL : threshold);
+        }
+
+        /** @return the policy (packed is a value returned by pack()) */
+        inline sampling unpack(uint64_t packed) {
+            if (packed == 0) {
+                return sampling();
+            }
+            if ((packed & PROBABILISTIC) == 0) {
+                return sampling::one_in(static_cast<unsigned int>(packed));
+            }
+
+            sampling policy;
+            policy.every = 0;
+            policy.probability = static_cast<double>(packed & 0xFFFFFFFFULL) / 4294967296.0;
+            return policy;
+        }
+
+        /** @return true if the message must be written (packed MUST NOT be 0)
+         *
+         * @param packed packed policy
+         * @param level message's log level
+         * @param owner logger that takes the decision (1-in-N counters are kept per logger)
+         */
+        inline bool keep(uint64_t packed, log_level level, const void *owner) {
+            if ((packed & PROBABILISTIC) != 0) {
+                // xorshift64*, seeded with the thread's state address and the clock
+                static thread_local uint64_t state = 0;
+                if (state == 0) {
+                    state = (reinterpret_cast<uintptr_t>(&state) ^ static_cast<uint64_t>(
+                            std::chrono::steady_clock::now().time_since_epoch().count())) | 1;
+                }
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+
+                return ((state * 0x2545F4914F6CDD1DULL) >> 32) < (packed & 0xFFFFFFFFULL);
+            }
+
+            // the counters of the last COUNTED_LOGGERS loggers the thread sampled for, the oldest ones are recycled.
+            static thread_local counters table[COUNTED_LOGGERS] = {};
+            static thread_local size_t recycled = 0;
+
+            counters *found = nullptr;
+            for (auto &current : table) {
+                if (current.owner == owner) {
+                    found = &current;
+                    break;
+                }
+            }
+            if (found == nullptr) {
+                found = &table[recycled++ % COUNTED_LOGGERS];
+                *found = counters{owner, {0}};
+            }
+
+            uint32_t &counter = found->values[level & 0xF];
+
+            return counter++ % static_cast<uint32_t>(packed) == 0;
+        }
+
+    } // namespace sampling_details
+
+    /** @} */
+
+} // namespace logger
+#endif
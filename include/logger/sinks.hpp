@@ -4,11 +4,8 @@
 
 #include "logger/facilities.hpp"
 
-#if __cplusplus >= 201703L
-#include <shared_mutex>
-#else
 #include <mutex>
-#endif
+#include <condition_variable>
 
 #include <thread> // std::mutex
 #include <atomic>
@@ -18,6 +15,8 @@
 #include <vector>   // std::unordered_map
 #include <unistd.h> // std::getpid
 #include <limits>
+#include <cstdint>  // uint64_t
+#include <memory>   // std::unique_ptr
 
 #ifndef CPP_LOGGER_SINKS_HPP
 #define CPP_LOGGER_SINKS_HPP
@@ -25,12 +24,174 @@
 #include "logger/definitions.hpp"
 #include <logger/facilities.hpp>
 #include <logger/exceptions.hpp>
+#include <logger/buffer.hpp>
+#include <logger/metrics.hpp>
 
 namespace logger {
     /** \addtogroup logger_log
      * @{
      */
 
+    template<class T, size_t Capacity> class async_sink;
+
+    class composite_sink;
+
+    struct field;
+
+    /** static description of a compile-time format string and of its argument types.
+     *
+     * Messages built with LOGGER_FORMAT share one descriptor per call site, binary sinks write it once and refer to it
+     * in each record (see binary_sink).
+     *
+     * @since v2.3.0
+     */
+    struct format_descriptor {
+        const char *format; //!< format string ({} placeholders)
+        const char *types;  //!< one type code per argument (i: signed, u: unsigned, d: floating point, c: char, b: bool, p: pointer, s: string)
+    };
+
+    /** a log message that knows how to render itself.
+     *
+     * Loggers hand messages to sinks through this interface (see sink::emit). The sink decides where the message is
+     * rendered, in most cases straight into its output buffer.
+     *
+     * @since v2.3.0
+     */
+    class message {
+    public:
+
+        /** append the message's text to a buffer.
+         *
+         * This can be called more than once.
+         *
+         * @param out buffer to fill.
+         */
+        virtual void render(buffer &out) const = 0;
+
+        /** @return the message's static descriptor, or nullptr if the message can only be rendered as text */
+        virtual const format_descriptor *descriptor() const {
+            return nullptr;
+        }
+
+        /** append the raw argument values to a buffer, as described by descriptor().
+         *
+         * Integers, floating point numbers and pointers take 8 bytes, chars and booleans take 1 byte, strings are
+         * written as a 4 bytes length followed by the characters (native byte order).
+         *
+         * @param out buffer to fill.
+         */
+        virtual void encode(buffer &) const {
+            // nothing to encode
+        }
+
+        /** append the message's text only, without the structured data it carries (see fields() and sampling_rate()).
+         *
+         * Sinks that render structured data their own way (i.e. json_file_sink) use this instead of render().
+         *
+         * @param out buffer to fill.
+         */
+        virtual void render_text(buffer &out) const {
+            render(out);
+        }
+
+        /** @param count receives the number of key/value fields
+         * @return the message's key/value fields, nullptr if it has none
+         */
+        virtual const field *fields(size_t &count) const {
+            count = 0;
+            return nullptr;
+        }
+
+        /** @return fraction of messages kept by a sampling policy (1 if the message was not sampled) */
+        virtual double sampling_rate() const {
+            return 1;
+        }
+
+    protected:
+        ~message() = default;
+    };
+
+    /** printf like message.
+     *
+     * @since v2.3.0
+     */
+    class printf_message : public message {
+    public:
+
+        /** new instance.
+         *
+         * @param fmt pointer to a null-terminated multibyte string specifying how to interpret the data. (see printf for more informations)
+         * @param args data to print (a copy is kept until this instance is destroyed).
+         */
+        printf_message(const char *fmt, va_list args) : _fmt(fmt) {
+            va_copy(_args, args);
+        }
+
+        printf_message(const printf_message &) = delete;
+        printf_message &operator=(const printf_message &) = delete;
+
+        ~printf_message() {
+            va_end(_args);
+        }
+
+        /** \copydoc message::render() */
+        void render(buffer &out) const override {
+            va_list args;
+            va_copy(args, _args);
+            out.vprintf(_fmt, args);
+            va_end(args);
+        }
+
+    private:
+        const char      *_fmt;  //!< format string
+        mutable va_list  _args; //!< format parameters
+    };
+
+    /** message that was kept by a sampling policy (see logger::set_sampling).
+     *
+     * The sampling rate is rendered as a structured data element before the message (i.e. `[S RATE="0.001"] `), so that
+     * downstream tools can re-weight what they count. Sampled messages are always rendered as text.
+     *
+     * @since v2.3.0
+     */
+    class sampled_message : public message {
+    public:
+
+        /** new instance.
+         *
+         * @param rate fraction of messages that are written (i.e. 0.001 for 1 in 1000)
+         * @param msg sampled message (MUST outlive this instance)
+         */
+        sampled_message(double rate, const message &msg) : _rate(rate), _message(msg) {
+            // intentional...
+        }
+
+        /** \copydoc message::render() */
+        void render(buffer &out) const override {
+            out.printf("[S RATE=\"%g\"] ", _rate);
+            _message.render(out);
+        }
+
+        /** \copydoc message::render_text() */
+        void render_text(buffer &out) const override {
+            _message.render_text(out);
+        }
+
+        /** \copydoc message::fields() */
+        const field *fields(size_t &count) const override {
+            return _message.fields(count);
+        }
+
+        /** \copydoc message::sampling_rate() */
+        double sampling_rate() const override {
+            return _rate;
+        }
+
+    private:
+        double         _rate;    //!< sampling rate
+        const message &_message; //!< sampled message
+    };
+
     /** Logging message sink (destination).
      *
      * A sink is in charge of sending messages to a specific destination in a proper way. Loggers delegate to instances of this
@@ -46,6 +207,12 @@ namespace logger {
 
         friend class registry; //!< this will let registry's factory setup sinks in a simplified way
 
+        template<class T, size_t Capacity> friend class async_sink; //!< this will let async sinks setup the sink they decorate
+
+        friend class composite_sink; //!< this will let composite sinks setup their children
+
+        friend class logger; //!< loggers count accepted and filtered messages
+
         /** write operation.
          *
          * A sink should override this virtual pure method in order to provide the write method to logger instances.
@@ -56,6 +223,16 @@ namespace logger {
          */
         virtual void write(log_level level, const char *fmt, ...) = 0;
 
+        /** write a message that renders itself.
+         *
+         * The default implementation renders the message and passes it to write(). Sinks override this in order to
+         * render the message straight into their output buffer.
+         *
+         * @param level corresponding messages's log level.
+         * @param msg message to write
+         */
+        virtual void emit(log_level level, const message &msg);
+
         /** change the current log level.
          *
          * @param level new logging level
@@ -64,7 +241,9 @@ namespace logger {
 
         /** @return niveau courrant de journalisation
          */
-        log_levels level() ;
+        log_levels level() {
+            return _level.load(std::memory_order_relaxed);
+        };
 
         /** @return logger name */
         std::string &name() {
@@ -82,12 +261,29 @@ namespace logger {
          *
          * @param ecid new ecid
          */
-        void set_ecid(const std::string &ecid);
+        virtual void set_ecid(const std::string &ecid);
 
-        /** @return current execution ID.
+        /** @return current execution ID (the calling thread's ecid_guard takes precedence over the sink's ECID).
          */
         std::string ecid();
 
+        /** copy the current execution ID into a buffer.
+         *
+         * Unlike ecid(), this doesn't allocate anything nor take any lock: the ECID is stored in atomic words
+         * protected by a sequence counter, readers retry in the rare case a writer changed it during the copy. The
+         * calling thread's ecid_guard takes precedence over the sink's ECID.
+         *
+         * @param target buffer to fill (a terminating \0 is added)
+         * @param size target buffer size (ECID_SIZE is enough)
+         * @return number of characters written (not counting the terminating \0)
+         */
+        size_t ecid(char *target, size_t size);
+
+        /** @return what this sink did so far (counters of all threads). Sinks that decorate or fan out to other sinks
+         * add their counters.
+         */
+        virtual sink_metrics metrics();
+
         /** dispose of logger instance ressources
          */
         virtual ~sink();
@@ -120,15 +316,31 @@ namespace logger {
           */
          virtual void set_name (const std::string &name);
 
+        /** @param size number of bytes written (see metrics()) */
+        void count_bytes(size_t size) {
+            _metrics.bytes(size);
+        }
+
+        /** @param count number of lines (or packets) that couldn't be written (see metrics()) */
+        void count_errors(size_t count) {
+            _metrics.errors(count);
+        }
+
+        /** count a flush (see metrics()) */
+        void count_flush() {
+            _metrics.flush();
+        }
+
     private:
-#if __cplusplus >= 201703L
-        std::shared_mutex _shared_mutex; //!< used to protect access to sink's data
-#else
-        std::mutex        _mutex;        //!< used to protect access to sink's data
-#endif
+        static constexpr size_t ECID_WORDS = (ECID_SIZE + 7) / 8; //!< number of words needed to store a rendered ECID
 
-        // when _ecid is accessed, we need to do more than just set/get it's value. Therefore, we cannot use std::atomic
-        std::string       _ecid;   //!< execution control ID. Helps to track everything that was logged by one business operation
+        std::mutex        _ecid_mutex;    //!< serializes ECID writers (readers don't take it)
+
+        // execution control ID, helps to track everything that was logged by one business operation. It is stored
+        // pre-rendered ([M ECID="..."]) in atomic words, so that readers never take a lock (seqlock).
+        std::atomic<unsigned>  _ecid_sequence;          //!< odd while a writer is changing the ECID
+        std::atomic<uint64_t>  _ecid_size;              //!< number of characters of the rendered ECID
+        std::atomic<uint64_t>  _ecid_words[ECID_WORDS]; //!< rendered ECID
 
         // these are read-only, we don't need to handle concurrency
         std::string       _name;   //!< logging domain name (as for now, this is equal to the logger name)
@@ -136,8 +348,141 @@ namespace logger {
 
         std::atomic<log_level>     _level;  //!< current logging level
 
+        metric_shards              _metrics; //!< counters, sharded per thread
+
     }; // sink
 
+    /** thread-scoped execution ID.
+     *
+     * While an instance lives, messages logged by the thread that created it carry its ECID, whatever the ECID of the
+     * sinks is. This is meant for servers in which each worker thread handles a different business operation. Guards can
+     * be nested, the previous ECID is restored when a guard is destroyed.
+     *
+     * ```
+     * void handle(const request &req) {
+     *     logger::ecid_guard ecid(req.id());
+     *     log->info("handling request"); // [M ECID="<request ID>"]
+     * }
+     * ```
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class ecid_guard {
+    public:
+
+        /** set the calling thread's ECID.
+         *
+         * @param ecid execution ID (an empty string means no ECID)
+         */
+        explicit ecid_guard(const std::string &ecid);
+
+        /** set the calling thread's ECID.
+         *
+         * @param ecid execution ID (an empty string means no ECID)
+         */
+        explicit ecid_guard(const char *ecid);
+
+        /** restore the previous ECID of the calling thread.
+         */
+        ~ecid_guard();
+
+        ecid_guard(const ecid_guard &) = delete;
+        ecid_guard &operator=(const ecid_guard &) = delete;
+
+        /** @return the calling thread's innermost guard (nullptr if there is none) */
+        static const ecid_guard *current();
+
+        /** @return execution ID, as it was passed to the constructor */
+        const char *value() const {
+            return _value;
+        }
+
+        /** @return rendered execution ID ([M ECID="..."]) */
+        const char *rendered() const {
+            return _rendered;
+        }
+
+        /** @return number of characters of the rendered execution ID */
+        size_t rendered_size() const {
+            return _rendered_size;
+        }
+
+    private:
+
+        /** render the ECID and make this guard the calling thread's current one */
+        void install(const char *ecid, size_t size);
+
+        char              _value[MAXECIDLEN + 1]; //!< execution ID
+        char              _rendered[ECID_SIZE];   //!< rendered execution ID
+        size_t            _rendered_size;         //!< number of characters of the rendered execution ID
+        const ecid_guard *_previous;              //!< guard to restore
+    };
+
+    /** how a file_sink hands its lines to the kernel.
+     *
+     * @since v2.3.0
+     */
+    enum class io_backend {
+        stdio,  //!< fwrite/fflush on the sink's FILE (this is the default)
+        uring,  //!< asynchronous writes submitted with io_uring, falls back to writev if io_uring isn't available or without buffering
+        writev  //!< full buffers are gathered and written with one writev call
+    };
+
+    class uring_writer;
+
+    /** file sink buffering and flush policy.
+     *
+     * A file_sink either hands each line to its FILE right away (this is the default), or keeps lines in its own write
+     * buffer and writes them in one call when:
+     * - the buffer is full,
+     * - the timer expires (if an interval was set),
+     * - a line of the given level, or more severe, is written.
+     *
+     * A flush means the pending lines are written and the FILE is flushed, so that the data reaches the kernel.
+     *
+     * With io_backend::uring or io_backend::writev, the sink writes into the FILE's file descriptor: lines are batched
+     * into the buffers of a uring_writer and a flush submits them (flush() waits for the writes to complete). Without
+     * buffering, io_backend::uring is replaced by io_backend::writev: each line is a write the caller waits for, io_uring
+     * would only add a submission and a completion to it.
+     *
+     * @since v2.3.0
+     */
+    struct flush_policy {
+
+        /** new policy.
+         *
+         * @param buffer_size write buffer size in KB (0 means no buffering)
+         * @param interval pending lines are flushed at least every interval milliseconds (0 means no timer)
+         * @param level lines of this level, or more severe, are flushed right away (defaults to log_levels::err)
+         * @param backend how lines are written (defaults to io_backend::stdio)
+         */
+        explicit flush_policy(size_t buffer_size = 0, unsigned int interval = 0, log_level level = log_levels::err, io_backend backend = io_backend::stdio) :
+                buffer_size(buffer_size),
+                interval(interval),
+                level(level),
+                backend(backend) {
+            // intentional...
+        }
+
+        size_t       buffer_size; //!< write buffer size in KB (0 means no buffering)
+        unsigned int interval;    //!< timer interval in milliseconds (0 means no timer)
+        log_level    level;       //!< lines of this level, or more severe, are flushed right away
+        io_backend   backend;     //!< how lines are written
+    };
+
+    /** what caused a file_sink to flush, and how much it wrote.
+     *
+     * @since v2.3.0
+     */
+    struct flush_counters {
+        unsigned long long buffer_full; //!< the write buffer was full
+        unsigned long long timer;       //!< the timer expired
+        unsigned long long level;       //!< a severe line was written
+        unsigned long long requested;   //!< flush() was called
+        unsigned long long bytes;       //!< number of bytes handed to the FILE
+    };
+
     /** file sink.
      *
      * send log messages to FILE.
@@ -159,6 +504,16 @@ namespace logger {
          */
         file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file);
 
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param file output file.
+         * @param level initial log level (defaults to logger::log_levels::info)
+         * @param policy buffering and flush policy
+         */
+        file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file, const flush_policy &policy);
+
         /** new instance.
          *
          * Default initial values:
@@ -170,6 +525,38 @@ namespace logger {
          */
         explicit file_sink(FILE *file);
 
+        /** new instance.
+         *
+         * @param file output file.
+         * @param policy buffering and flush policy
+         */
+        file_sink(FILE *file, const flush_policy &policy);
+
+        /** write pending lines and stop the flush timer.
+         */
+        ~file_sink() override;
+
+        /** write pending lines and flush the FILE.
+         */
+        void flush();
+
+        /** @return what caused this sink to flush so far */
+        flush_counters counters() const;
+
+        /** @return buffering and flush policy */
+        const flush_policy &policy() const {
+            return _policy;
+        }
+
+        /** @return backend actually used (io_backend::writev if io_backend::uring was requested but isn't available) */
+        io_backend backend() const;
+
+        /** \copydoc sink::metrics()
+         *
+         * With io_backend::uring or io_backend::writev, bytes and errors are counted when the writes complete.
+         */
+        sink_metrics metrics() override ;
+
         /** \copydoc sink::write()
          *
          * This sink writes messages in FILE.
@@ -177,25 +564,127 @@ namespace logger {
          */
         void write(log_level level, const char *fmt, ...) override ;
 
+        /** \copydoc sink::emit()
+         *
+         * The line is rendered (see render_line()) in the calling thread's buffer, which is then written into the FILE.
+         */
+        void emit(log_level level, const message &msg) override ;
+
     protected:
 
+        friend class composite_sink; //!< composite sinks render a line once for the children that share a layout
+        template<class T, size_t Capacity> friend class async_sink; //!< async sinks render lines in the calling thread and output them later
+
+        /** render a whole log line: header, message and end-of-line.
+         *
+         * Host name, program name, process ID and subsystem are rendered once (again when they change or after a
+         * fork()), a line only renders the level, date and time, thread ID and ECID before the message.
+         *
+         * @param level message's log level
+         * @param msg message to render
+         * @param line buffer to fill
+         */
+        virtual void render_line(log_level level, const message &msg, buffer &line);
+
+        /** @return name of the line layout, sinks that have the same layout (and the same name, program name and ECID)
+         * render the same line for the same message.
+         *
+         * > **WARN** a subclass that overrides render_line() MUST override this too.
+         */
+        virtual const char *layout() const {
+            return "rfc5424";
+        }
+
         /** Set sybsystem name and reset fixed part of the output pattern.
          *
          * @param name sink name
          */
         void set_name(const std::string &name) override ;
 
-        /** fill the buffer with the current date and time information
+        /** Set program name and reset fixed part of the output pattern.
+         *
+         * @param name program name
+         */
+        void set_program_name(const std::string &name) override ;
+
+        /** @return the current date and time information (i.e. 2019-04-22T13:46:55.974395+02:00)
          */
         const std::string date_time();
 
+        /** hand a rendered log line to the output.
+         *
+         * file_sink writes the line into the FILE in one call. Subclasses can override this in order to send the
+         * rendered lines somewhere else.
+         *
+         * @param level message's log level
+         * @param data rendered line (header, message and end-of-line)
+         * @param size number of characters to write
+         */
+        virtual void output(log_level level, const char *data, size_t size);
+
+        /** fill the buffer with the current date and time information.
+         *
+         * The date and time part is only rendered once per second and per thread, each call only renders the
+         * microseconds.
+         *
+         * @param target buffer to fill (a terminating \0 is added)
+         * @param size target buffer size (DATE_TIME_SIZE is enough)
+         * @return number of characters written (not counting the terminating \0), 0 if target is too small.
+         */
+        size_t date_time(char *target, size_t size);
+
+        /** @return host name */
+        const std::string &hostname() const {
+            return _hostname;
+        }
+
+        /** @return process ID */
+        pid_t pid() const {
+            return _pid;
+        }
+
     private:
 
+        /** write pending lines and flush the FILE (MUST be called with _output_mutex locked).
+         *
+         * @param counter counter to increment
+         */
+        void flush_pending(std::atomic<unsigned long long> &counter);
+
+        /** flush timer body */
+        void run_timer();
+
+        /** render the parts of the header that don't change from one line to the next (host name, program name,
+         * process ID and subsystem).
+         */
+        void render_header();
+
+        /** called in the child process after a fork(), the process ID of each file_sink's header is updated and the
+         * flush timers are started again.
+         */
+        static void after_fork();
+
         FILE             *_file_descriptor; //!< file descriptor of a log file
+        flush_policy      _policy;   //!< buffering and flush policy
+        buffer            _pending;  //!< lines waiting to be written (when buffering is on)
+        std::unique_ptr<uring_writer> _writer; //!< io_uring/writev backend (nullptr with io_backend::stdio)
+        std::mutex        _output_mutex; //!< protects _pending
+
+        std::atomic<unsigned long long> _buffer_full_flushes; //!< flushes caused by a full buffer
+        std::atomic<unsigned long long> _timer_flushes;       //!< flushes caused by the timer
+        std::atomic<unsigned long long> _level_flushes;       //!< flushes caused by severe lines
+        std::atomic<unsigned long long> _requested_flushes;   //!< flushes caused by flush()
+        std::atomic<unsigned long long> _bytes;               //!< bytes handed to the FILE
+
+        bool                    _stopping;        //!< true when the timer must stop (protected by _output_mutex)
+        std::condition_variable _timer_condition; //!< used to stop the timer
+        std::thread             _timer;           //!< flush timer (only started if needed)
+
         pid_t             _pid;      //!< process ID
         std::string       _lag;      //!< date time lag (i.e. +02:00)
         std::string       _hostname; //!< hostname (this will be displayed by log messages)
-        std::string       _pattern;  //!< message pattern (layout)
+        std::string       _header;    //!< pre-rendered host name, program name and process ID (i.e. "web-1 shop.4242.")
+        std::string       _subsystem; //!< pre-rendered subsystem (i.e. "[L SUBSYS=orders] ")
     };
 
     /** stdout sink.
@@ -220,6 +709,15 @@ namespace logger {
          */
         explicit stdout_sink() ;
 
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param policy buffering and flush policy (io_backend::uring is worth it when stdout is redirected to a file)
+         */
+        stdout_sink(const std::string &name, const std::string &pname, log_level level, const flush_policy &policy);
+
     };
 
     /** stderr sink.
@@ -244,13 +742,29 @@ namespace logger {
          */
         explicit stderr_sink();
 
+        /** new instance.
+         *
+         * @param name sink name
+         * @param pname program name
+         * @param level initial log level
+         * @param policy buffering and flush policy (io_backend::uring is worth it when stderr is redirected to a file)
+         */
+        stderr_sink(const std::string &name, const std::string &pname, log_level level, const flush_policy &policy);
+
     };
 
     /** syslog sink.
      *
      * Send log messages to syslogd (more [here(https://en.wikipedia.org/wiki/Syslog))
      *
-     * > **WARN**  The syslog_sink, considers that TRACE and DEBUG are the same.
+     * Each sink has its own UNIX datagram socket connected to syslogd's socket (/dev/log by default) and builds the
+     * RFC5424 packets itself, so sinks with different facilities don't clobber each other (::openlog() is process
+     * global). Packets can be batched: they're then sent with one sendmmsg call once batch packets are pending, when a
+     * severe message (err or worse) is written, on flush(), when the sink is destroyed, and at least every interval
+     * milliseconds (so that a quiet program's packets don't wait forever).
+     *
+     * > **WARN**  The syslog_sink, considers that TRACE and DEBUG are the same. Supported options are LOG_PID, LOG_NDELAY
+     * > and LOG_PERROR. If syslogd can't be reached, packets are dropped (see dropped()).
      *
      * @author herbert koelman
      * @since v1.4.0
@@ -269,6 +783,21 @@ namespace logger {
          */
         syslog_sink(const std::string &name, const std::string &pname, log_level level, const syslog::facility &facility, int options );
 
+        /** new instance.
+         *
+         * @param name nom du journal
+         * @param pname program name
+         * @param level initial log level
+         * @param facility syslog facility to use
+         * @param options syslog options (see above)
+         * @param path path of syslogd's socket (defaults to /dev/log)
+         * @param batch number of packets sent per sendmmsg call (1 means each packet is sent right away)
+         * @param interval pending packets are sent at least every interval milliseconds (0 means no timer, batches only)
+         * @throws sink_exception if the socket cannot be created
+         * @since v2.3.0
+         */
+        syslog_sink(const std::string &name, const std::string &pname, log_level level, const syslog::facility &facility, int options, const std::string &path, unsigned int batch = 1, unsigned int interval = SYSLOG_BATCH_INTERVAL);
+
        /** new instance.
          *
          * @param facility syslog facility to use (default is "user")
@@ -278,6 +807,18 @@ namespace logger {
          */
         syslog_sink(const syslog::facility &facility, int options);
 
+        /** new instance.
+         *
+         * @param facility syslog facility to use
+         * @param options syslog options
+         * @param path path of syslogd's socket
+         * @param batch number of packets sent per sendmmsg call
+         * @param interval pending packets are sent at least every interval milliseconds (0 means no timer)
+         * @throws sink_exception if the socket cannot be created
+         * @since v2.3.0
+         */
+        syslog_sink(const syslog::facility &facility, int options, const std::string &path, unsigned int batch = 1, unsigned int interval = SYSLOG_BATCH_INTERVAL);
+
        /** new instance.
          *
          * @param name nom du journal
@@ -291,7 +832,9 @@ namespace logger {
          */
         explicit syslog_sink();
 
-        ~syslog_sink() = default ;
+        /** stop the timer, send pending packets and close the socket.
+         */
+        ~syslog_sink() override;
 
         /** \copydoc  sink::write
          *
@@ -299,12 +842,77 @@ namespace logger {
          */
         void write(log_level level, const char *fmt, ...) override ;
 
+        /** \copydoc sink::emit()
+         *
+         * The message is rendered right after the RFC5424 header, in the packet that is sent to syslogd.
+         */
+        void emit(log_level level, const message &msg) override ;
+
+        /** send pending packets.
+         */
+        void flush();
+
+        /** @return number of packets sent to syslogd */
+        unsigned long long sent() const {
+            return _sent.load(std::memory_order_relaxed);
+        }
+
+        /** @return number of packets that couldn't be sent (syslogd not reachable, ...) */
+        unsigned long long dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+
     protected:
 
         void set_name(const std::string &name) override ;
 
     private:
-        std::string _pattern; //!< message pattern (layout)
+
+        /** send packets, reconnect once if syslogd was restarted.
+         *
+         * @param data packets, one after the other
+         * @param ends end offset of each packet in data
+         * @param count number of packets
+         */
+        void transmit(const char *data, const size_t *ends, size_t count);
+
+        /** (re)connect the socket to syslogd.
+         *
+         * @return false if syslogd cannot be reached
+         */
+        bool connect();
+
+        /** timer thread body: send pending packets every interval milliseconds */
+        void run_timer();
+
+        /** called in the child process after a fork(), the process ID of each syslog_sink is updated and the batch
+         * timers are started again.
+         */
+        static void after_fork();
+
+        std::string _pattern;  //!< message pattern (layout)
+        std::string _path;     //!< path of syslogd's socket
+        std::string _hostname; //!< hostname
+        std::string _procid;   //!< process ID (- if LOG_PID wasn't set)
+        int         _facility; //!< facility code
+        int         _options;  //!< syslog options
+        int         _socket;   //!< datagram socket (never closed before the sink is destroyed)
+        unsigned int _batch;   //!< number of packets per sendmmsg call
+        unsigned int _interval; //!< time pending packets may wait (0 means no timer)
+
+        std::atomic<bool>  _connected;      //!< true once the socket is connected
+        std::mutex         _connect_mutex;  //!< serializes (re)connections
+
+        std::mutex          _batch_mutex;   //!< protects what follows
+        buffer              _packets;       //!< pending packets
+        std::vector<size_t> _ends;          //!< end offset of each pending packet
+        bool                _stopping;      //!< true when the timer must stop
+
+        std::condition_variable _timer_condition; //!< used to stop the timer
+        std::thread             _timer;           //!< timer that sends pending packets (only started for batches)
+
+        std::atomic<unsigned long long> _sent;    //!< packets sent
+        std::atomic<unsigned long long> _dropped; //!< packets dropped
     };
 
     /** @} */
@@ -0,0 +1,294 @@
+/*
+ * logger::staged_sink - herbert koelman
+ *
+ * file sink decorator: threads stage their rendered lines in their own ring, a merger thread writes them in order.
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>   // std::stable_sort
+#include <type_traits> // std::is_base_of
+#include <vector>
+#include <cstdint>     // uint64_t
+#include <cstring>     // std::memcpy
+
+#ifndef CPP_LOGGER_STAGED_SINK_HPP
+#define CPP_LOGGER_STAGED_SINK_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+#include <logger/staging.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr unsigned int STAGED_SINK_INTERVAL = 10; //!< merge period of a staged_sink in milliseconds
+
+    /** how a staged_sink orders the lines of different threads.
+     *
+     * @since v2.3.0
+     */
+    enum class staging_order {
+        timestamp, //!< lines are ordered by the (monotonic) time they were written, threads share nothing
+        sequence   //!< lines are written in the order of a process wide sequence number (one atomic increment per line)
+    };
+
+    /** file sink decorator with per-thread staging.
+     *
+     * The calling thread renders its line as usual (header, timestamp, ECID...), then appends it to its own staging ring
+     * (see staging_area) instead of writing it: no lock, no FILE, no shared state. A merger thread collects the rings every
+     * STAGED_SINK_INTERVAL milliseconds, orders the lines and writes them with the decorated sink's output().
+     *
+     * With staging_order::timestamp, lines younger than one merge period are kept for the next merge, so that a line that
+     * was staged a bit late still lands in order. With staging_order::sequence, the merger only writes lines up to the
+     * first missing sequence number: a thread that was preempted before it staged its line holds back the lines that
+     * follow it, whatever the delay. Lines too large for a ring are handed to the merger directly. When a thread exits, its ring is merged before it is forgotten; when the sink is destroyed, every
+     * staged line is written. A thread whose ring is full waits for the merger, lines are never dropped.
+     *
+     * ```
+     * auto log = logger::get<logger::staged_sink<logger::file_sink>>("workers", file);
+     * ```
+     *
+     * > **WARN** flush() writes every staged line right away, lines staged later with an older timestamp are written
+     * > after them.
+     *
+     * @tparam T decorated sink type (file_sink or one of its subclasses)
+     * @tparam Order how lines of different threads are ordered
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    template<class T, staging_order Order = staging_order::timestamp> class staged_sink : public T {
+    public:
+
+        static_assert(std::is_base_of<file_sink, T>::value, "staged_sink decorates file sinks");
+
+        /** new instance.
+         *
+         * The decorated sink is built with the given arguments, the merger thread is started right after.
+         *
+         * @tparam Args decorated sink constructor argument variadic
+         * @param args decorated sink constructor arguments
+         */
+        template<typename... Args> explicit staged_sink(const Args&... args) :
+                T(args...),
+                _sequence(0),
+                _active(0),
+                _next(0),
+                _running(true),
+                _sleeping(false) {
+
+            _merger = std::thread(&staged_sink::run, this);
+        }
+
+        /** stop the merger thread once every staged line was written.
+         */
+        ~staged_sink() override {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _running.store(false);
+            }
+            _condition.notify_one();
+
+            if (_merger.joinable()) {
+                _merger.join();
+            }
+        }
+
+        /** write every staged line and flush the decorated sink.
+         */
+        void flush() {
+            {
+                std::lock_guard<std::mutex> lock(_merge_mutex);
+                merge(true);
+            }
+            T::flush();
+        }
+
+    protected:
+
+        /** stage the rendered line in the calling thread's ring.
+         *
+         * \copydetails file_sink::output()
+         */
+        void output(log_level level, const char *data, size_t size) override {
+            record header{
+                    now(),
+                    Order == staging_order::sequence ? _sequence.fetch_add(1, std::memory_order_relaxed) : 0,
+                    static_cast<int32_t>(level),
+                    0
+            };
+
+            staging_ring &ring = _staging.ring();
+
+            while (!ring.push(reinterpret_cast<const char *>(&header), sizeof(header), data, size)) {
+                // the line may never fit, or the merger is gone: hand it to the merger ourselves
+                if (sizeof(header) + size > ring.max_record_size() || !_running.load()) {
+                    std::lock_guard<std::mutex> lock(_merge_mutex);
+                    collect(header, data, size);
+                    if (!_running.load()) {
+                        merge(true);
+                    }
+                    return;
+                }
+
+                // the ring is full, wait for the merger
+                _condition.notify_one();
+                std::this_thread::yield();
+            }
+
+            if (ring.half_full() && _sleeping.load(std::memory_order_relaxed)) {
+                _condition.notify_one();
+            }
+        }
+
+    private:
+
+        /** what precedes each staged line */
+        struct record {
+            uint64_t timestamp; //!< monotonic nanoseconds
+            uint64_t sequence;  //!< process wide sequence number (staging_order::sequence only)
+            int32_t  level;     //!< log level
+            uint32_t padding;
+        };
+
+        /** a line collected by the merger */
+        struct pending {
+            uint64_t  key;       //!< sort key (timestamp or sequence)
+            uint64_t  timestamp; //!< monotonic nanoseconds
+            log_level level;     //!< log level
+            size_t    offset;    //!< line offset in the active records buffer
+            size_t    size;      //!< line size
+        };
+
+        /** @return monotonic nanoseconds */
+        static uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        /** add a line to the collected ones (MUST be called with _merge_mutex locked).
+         *
+         * @param header line's record
+         * @param data line
+         * @param size line size
+         */
+        void collect(const record &header, const char *data, size_t size) {
+            buffer &records = _records[_active];
+
+            _pending.push_back(pending{
+                    Order == staging_order::sequence ? header.sequence : header.timestamp,
+                    header.timestamp,
+                    static_cast<log_level>(header.level),
+                    records.size(),
+                    size
+            });
+            records.append(data, size);
+        }
+
+        /** collect the staged lines, write the ones that are ready (MUST be called with _merge_mutex locked).
+         *
+         * @param everything true to write every line, whatever its age or the sequence numbers that are missing
+         */
+        void merge(bool everything) {
+            buffer &records = _records[_active];
+
+            _staging.for_each([this](staging_ring &ring) {
+                ring.drain([this](const char *data, size_t size) {
+                    record header{};
+                    memcpy(&header, data, sizeof(header));
+                    collect(header, data + sizeof(header), size - sizeof(header));
+                });
+            });
+
+            if (_pending.empty()) {
+                return;
+            }
+
+            // each ring is already in order, stable_sort keeps it that way for equal keys
+            std::stable_sort(_pending.begin(), _pending.end(), [](const pending &left, const pending &right) {
+                return left.key < right.key;
+            });
+
+            uint64_t cutoff = now() - static_cast<uint64_t>(STAGED_SINK_INTERVAL) * 1000000;
+            size_t written = 0;
+
+            for (; written < _pending.size(); written++) {
+                const pending &line = _pending[written];
+                if (Order == staging_order::sequence) {
+                    if (!everything && line.key > _next) {
+                        break; // the line that comes before wasn't staged yet
+                    }
+                    // a line older than _next was held back by a flush(), it is written as soon as it shows up
+                    if (line.key >= _next) {
+                        _next = line.key + 1;
+                    }
+                } else if (!everything && line.timestamp > cutoff) {
+                    break; // younger lines wait for the next merge
+                }
+                T::output(line.level, records.data() + line.offset, line.size);
+            }
+
+            // keep the lines that were not written in the other buffer
+            buffer &kept = _records[1 - _active];
+            kept.clear();
+
+            _kept.clear();
+            for (size_t index = written; index < _pending.size(); index++) {
+                pending line = _pending[index];
+                kept.append(records.data() + line.offset, line.size);
+                line.offset = kept.size() - line.size;
+                _kept.push_back(line);
+            }
+
+            records.clear();
+            _pending.swap(_kept);
+            _active = 1 - _active;
+        }
+
+        /** merger thread body */
+        void run() {
+            while (_running.load()) {
+                {
+                    std::lock_guard<std::mutex> lock(_merge_mutex);
+                    merge(false);
+                }
+
+                std::unique_lock<std::mutex> lock(_mutex);
+                _sleeping.store(true);
+                if (_running.load()) {
+                    _condition.wait_for(lock, std::chrono::milliseconds(STAGED_SINK_INTERVAL));
+                }
+                _sleeping.store(false);
+            }
+
+            std::lock_guard<std::mutex> lock(_merge_mutex);
+            merge(true);
+        }
+
+        staging_area            _staging;     //!< per-thread staging rings
+        std::atomic<uint64_t>   _sequence;    //!< next sequence number (staging_order::sequence only)
+
+        std::mutex              _merge_mutex; //!< serializes merges, protects what follows
+        buffer                  _records[2];  //!< collected lines (the active one, and the one that receives lines kept for the next merge)
+        int                     _active;      //!< index of the active records buffer
+        std::vector<pending>    _pending;     //!< collected lines
+        std::vector<pending>    _kept;        //!< lines kept for the next merge
+        uint64_t                _next;        //!< sequence number of the next line to write (staging_order::sequence only)
+
+        std::atomic<bool>       _running;     //!< false when the merger thread must stop
+        std::atomic<bool>       _sleeping;    //!< true when the merger thread waits for the next merge
+        std::mutex              _mutex;       //!< used to put the merger thread asleep
+        std::condition_variable _condition;   //!< used to wake up the merger thread
+        std::thread             _merger;      //!< merger thread
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
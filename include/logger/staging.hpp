@@ -0,0 +1,239 @@
+/*
+ * logger::staging - herbert koelman
+ *
+ * per-thread staging rings. Each thread appends records to its own ring, a single consumer collects them.
+ */
+
+#include <atomic>
+#include <mutex>
+#include <memory>   // std::shared_ptr, std::unique_ptr
+#include <vector>
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstring>  // std::memcpy
+
+#ifndef CPP_LOGGER_STAGING_HPP
+#define CPP_LOGGER_STAGING_HPP
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t STAGING_RING_SIZE = 1 << 20; //!< default size (in bytes) of a thread's staging ring
+
+    /** single-producer/single-consumer ring of variable size records.
+     *
+     * The producer is the thread that owns the ring, the consumer is the sink that collects the records. Neither side
+     * takes a lock. When the ring is full, records are dropped and accounted for (see dropped()).
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class staging_ring {
+    public:
+
+        /** new ring.
+         *
+         * @param capacity size in bytes (rounded up to a power of 2)
+         */
+        explicit staging_ring(size_t capacity);
+
+        staging_ring(const staging_ring &) = delete;
+        staging_ring &operator=(const staging_ring &) = delete;
+
+        /** append a record (producer side).
+         *
+         * @param data record content
+         * @param size record size
+         * @return false if the record didn't fit (it's then dropped), or the ring was retired
+         */
+        bool push(const char *data, size_t size);
+
+        /** append a record made of two parts, i.e. a fixed size header followed by a payload (producer side).
+         *
+         * Unlike push(data, size), a record that doesn't fit is not accounted for as dropped: the caller may try again
+         * once the consumer made room.
+         *
+         * @param header first part of the record
+         * @param header_size size of the first part
+         * @param data second part of the record
+         * @param size size of the second part
+         * @return false if the record didn't fit, or the ring was retired
+         */
+        bool push(const char *header, size_t header_size, const char *data, size_t size);
+
+        /** hand every available record to a function (consumer side).
+         *
+         * @tparam F callable with this signature: void(const char *data, size_t size)
+         * @param consume called once per record, the data is only valid during the call
+         * @return number of records consumed
+         */
+        template<class F> size_t drain(F consume) {
+            size_t count = 0;
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            size_t head = _head.load(std::memory_order_acquire);
+
+            while (tail != head) {
+                size_t offset = tail & (_capacity - 1);
+                uint32_t size = 0;
+                memcpy(&size, _data.get() + offset, sizeof(size));
+
+                if (size == PADDING) {
+                    tail += _capacity - offset; // the next record starts at the beginning of the ring
+                } else {
+                    consume(static_cast<const char *>(_data.get() + offset + HEADER_SIZE), static_cast<size_t>(size));
+                    tail += aligned(size);
+                    count++;
+                }
+
+                _tail.store(tail, std::memory_order_release);
+            }
+
+            return count;
+        }
+
+        /** tell the consumer that the producer thread is gone (no more records will be pushed).
+         */
+        void close() {
+            _closed.store(true, std::memory_order_release);
+        }
+
+        /** @return true if the producer thread is gone */
+        bool closed() const {
+            return _closed.load(std::memory_order_acquire);
+        }
+
+        /** tell the producer that the consumer is gone: push() fails from now on, the memory is given back when the
+         * producer forgets the ring.
+         */
+        void retire() {
+            _retired.store(true, std::memory_order_release);
+        }
+
+        /** @return true if the consumer is gone */
+        bool retired() const {
+            return _retired.load(std::memory_order_acquire);
+        }
+
+        /** @return true if there is nothing to consume */
+        bool empty() const {
+            return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+        }
+
+        /** @return true if more than half of the ring is in use (it's time to wake up the consumer) */
+        bool half_full() const {
+            return _head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_relaxed) > _capacity / 2;
+        }
+
+        /** @return ring size in bytes */
+        size_t capacity() const {
+            return _capacity;
+        }
+
+        /** @return size of the largest record that fits once the consumer emptied the ring, wherever the producer
+         * position is (records are never split, the end of the ring may have to be skipped)
+         */
+        size_t max_record_size() const {
+            return _capacity / 2 - HEADER_SIZE;
+        }
+
+        /** @return number of records that didn't fit */
+        unsigned long long dropped() const {
+            return _dropped.load(std::memory_order_relaxed);
+        }
+
+        /** @return producer's thread ID (as reported by the system, i.e. gettid on Linux) */
+        uint64_t thread_id() const {
+            return _thread_id;
+        }
+
+    private:
+
+        static constexpr uint32_t PADDING     = 0xFFFFFFFF; //!< marks the unused end of the ring
+        static constexpr size_t   HEADER_SIZE = 8;          //!< record size + padding (keeps records 8 bytes aligned)
+
+        /** @return the room taken by a record of the given size */
+        static size_t aligned(size_t size) {
+            return (HEADER_SIZE + size + 7) & ~static_cast<size_t>(7);
+        }
+
+        std::unique_ptr<char[]>         _data;      //!< ring content
+        size_t                          _capacity;  //!< ring size (power of 2)
+        std::atomic<size_t>             _head;      //!< producer position
+        char                            _padding[64]; //!< keep producer and consumer positions on separate cache lines
+        std::atomic<size_t>             _tail;      //!< consumer position
+        std::atomic<bool>               _closed;    //!< true when the producer thread is gone
+        std::atomic<bool>               _retired;   //!< true when the consumer is gone
+        std::atomic<unsigned long long> _dropped;   //!< number of records that didn't fit
+        uint64_t                        _thread_id; //!< producer's thread ID
+    };
+
+    /** set of staging rings, one per producer thread.
+     *
+     * Each thread that logs gets its own ring the first time it calls ring(). When a thread exits, its ring is closed
+     * and it's dropped once the consumer emptied it, so nothing is lost when worker pools shrink. When the staging area
+     * is destroyed, its rings are retired: the threads forget them the next time they look for a ring (or when they
+     * exit), which is when their memory is given back.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class staging_area {
+    public:
+
+        /** new staging area.
+         *
+         * @param ring_size size of each thread's ring (defaults to STAGING_RING_SIZE)
+         */
+        explicit staging_area(size_t ring_size = STAGING_RING_SIZE);
+
+        /** retire all the rings.
+         */
+        ~staging_area();
+
+        staging_area(const staging_area &) = delete;
+        staging_area &operator=(const staging_area &) = delete;
+
+        /** @return the calling thread's ring (it is created on first use) */
+        staging_ring &ring();
+
+        /** visit every ring (consumer side).
+         *
+         * Closed rings are forgotten once they're empty.
+         *
+         * @tparam F callable with this signature: void(staging_ring &)
+         * @param visit called once per ring
+         */
+        template<class F> void for_each(F visit) {
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            for (auto current = _rings.begin(); current != _rings.end();) {
+                bool closed = (*current)->closed(); // must be read before draining
+                visit(**current);
+
+                if (closed && (*current)->empty()) {
+                    _dropped += (*current)->dropped();
+                    current = _rings.erase(current);
+                } else {
+                    ++current;
+                }
+            }
+        }
+
+        /** @return number of records that were dropped because a ring was full */
+        unsigned long long dropped();
+
+    private:
+
+        uint64_t                                   _id;        //!< unique ID, used by threads to find their ring
+        size_t                                     _ring_size; //!< size of each ring
+        std::mutex                                 _mutex;     //!< protects the list of rings
+        std::vector<std::shared_ptr<staging_ring>> _rings;     //!< one ring per producer thread
+        unsigned long long                         _dropped;   //!< records dropped by forgotten rings
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
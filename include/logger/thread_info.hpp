@@ -0,0 +1,57 @@
+/*
+ * logger::thread_info - herbert koelman
+ *
+ * identity of the calling thread (kernel thread ID and name), looked up once per thread.
+ */
+
+#include <string>   // std::string
+#include <cstddef>  // size_t
+
+#ifndef CPP_LOGGER_THREAD_INFO_HPP
+#define CPP_LOGGER_THREAD_INFO_HPP
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr size_t THREAD_NAME_SIZE = 16; //!< size of a buffer that can hold a thread name (15 characters and a \0, as on Linux)
+    constexpr size_t THREAD_ID_SIZE   = 24; //!< size of a buffer that can hold a rendered thread ID
+
+    /** identity of a thread, as shown by `top -H`, `ps -L` or perf.
+     *
+     * Sinks render it with no system call nor conversion: it's looked up the first time a thread logs, and kept in a
+     * thread_local.
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    struct thread_info {
+        long   id;                          //!< kernel thread ID (gettid on Linux, pthread_self elsewhere)
+        char   rendered_id[THREAD_ID_SIZE]; //!< id in decimal (not \0 terminated)
+        size_t rendered_id_size;            //!< number of characters in rendered_id
+        char   name[THREAD_NAME_SIZE];      //!< thread name (\0 terminated, empty if unknown)
+        size_t name_size;                   //!< number of characters in name
+    };
+
+    /** @return the calling thread's identity.
+     *
+     * After a fork(), the child's thread gets its new ID. A name changed with anything but set_thread_name() is only
+     * seen by threads that didn't log yet.
+     *
+     * @since v2.3.0
+     */
+    const thread_info &current_thread();
+
+    /** name the calling thread (i.e. pthread_setname_np), names are truncated to 15 characters.
+     *
+     * @param name new thread name
+     * @since v2.3.0
+     */
+    void set_thread_name(const std::string &name);
+
+    /** @} */
+
+} // namespace logger
+#endif
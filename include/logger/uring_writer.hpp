@@ -0,0 +1,162 @@
+/*
+ * logger::uring_writer - herbert koelman
+ *
+ * batches rendered lines into fixed buffers and writes them with io_uring (or writev when io_uring isn't available).
+ */
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstddef>  // size_t
+#include <sys/uio.h> // iovec
+
+#ifndef CPP_LOGGER_URING_WRITER_HPP
+#define CPP_LOGGER_URING_WRITER_HPP
+
+#include "logger/definitions.hpp"
+#include <logger/sinks.hpp>
+
+namespace logger {
+
+    /** \addtogroup logger_log
+     * @{
+     */
+
+    constexpr unsigned int URING_WRITER_BUFFERS = 8; //!< default number of fixed buffers of a uring_writer
+
+    /** write backend of file sinks (see flush_policy and io_backend).
+     *
+     * Lines are copied into a set of fixed buffers, registered with io_uring when possible. Full buffers are submitted
+     * as asynchronous writes, the caller doesn't wait for them: completions are reaped by a background thread, which
+     * gives the buffers back. Buffers submitted together are linked, and a batch is only submitted once the previous one
+     * was reaped (buffers filled in the meantime join the next batch), so that the file receives the lines in order. If a
+     * write fails or is short, the reaper writes the rest synchronously before the next batch is submitted.
+     *
+     * If io_uring is not available (old kernel, seccomp, ...), or if io_backend::writev is requested, full buffers are
+     * gathered and written synchronously with one writev call.
+     *
+     * > **WARN** this class is not thread safe, callers must serialize append/submit/wait (file_sink does it with its
+     * > output mutex).
+     *
+     * @author herbert koelman
+     * @since v2.3.0
+     */
+    class uring_writer {
+    public:
+
+        /** new instance.
+         *
+         * @param fd file descriptor to write to (it is not closed)
+         * @param buffer_size size of each buffer in bytes
+         * @param backend io_backend::uring (falls back to writev if io_uring isn't available) or io_backend::writev
+         * @param buffers number of buffers (at least 2)
+         */
+        uring_writer(int fd, size_t buffer_size, io_backend backend = io_backend::uring, unsigned int buffers = URING_WRITER_BUFFERS);
+
+        /** write what's pending, wait for the completions and release io_uring.
+         */
+        ~uring_writer();
+
+        uring_writer(const uring_writer &) = delete;
+        uring_writer &operator=(const uring_writer &) = delete;
+
+        /** copy data into the current buffer, full buffers are submitted.
+         *
+         * This only waits when every buffer is still being written, or full and waiting for the previous batch.
+         *
+         * @param data data to write
+         * @param size number of bytes
+         * @return true if a full buffer was submitted
+         */
+        bool append(const char *data, size_t size);
+
+        /** submit the current buffer, even if it's not full (this waits for the previous batch, not for this one).
+         */
+        void submit();
+
+        /** submit the current buffer and wait until every write completed.
+         */
+        void wait();
+
+        /** @return number of bytes appended but not submitted yet */
+        size_t pending() const;
+
+        /** @return io_backend::uring if io_uring is used, io_backend::writev otherwise */
+        io_backend backend() const {
+            return _ring >= 0 ? io_backend::uring : io_backend::writev;
+        }
+
+        /** @return number of submissions (io_uring_enter or writev calls) */
+        unsigned long long submissions() const {
+            return _submissions.load(std::memory_order_relaxed);
+        }
+
+        /** @return number of failed writes (what couldn't be written is lost, short writes are completed synchronously) */
+        unsigned long long errors() const {
+            return _errors.load(std::memory_order_relaxed);
+        }
+
+        /** @return number of bytes that reached the file descriptor */
+        unsigned long long bytes() const {
+            return _bytes.load(std::memory_order_relaxed);
+        }
+
+    private:
+
+        /** a fixed buffer */
+        struct slot {
+            char   *data; //!< buffer (page aligned)
+            size_t  size; //!< number of bytes in the buffer
+            bool    busy; //!< true while the kernel writes it (protected by _mutex)
+        };
+
+        bool setup(unsigned int entries);   //!< set the ring up, false if io_uring isn't available
+        void teardown();                    //!< release the ring
+        void submit_ready();                //!< write or submit the buffers that are ready
+        void enter(unsigned int count);     //!< tell the kernel about count new submission entries
+        void wait_free(size_t index);       //!< wait until the kernel is done with the buffer
+        bool idle();                        //!< true if no write is in flight
+        size_t write_all(const char *data, size_t size); //!< synchronous write, returns the number of bytes written
+        void reap();                        //!< reaper thread body
+
+        int                     _fd;          //!< target file descriptor
+        size_t                  _buffer_size; //!< size of each buffer
+        std::vector<slot>       _slots;       //!< buffers
+        std::vector<iovec>      _vectors;     //!< used by writev and to register the buffers
+        size_t                  _current;     //!< buffer being filled
+        size_t                  _ready;       //!< number of full buffers (right before _current) not submitted yet
+
+        int                     _ring;        //!< io_uring file descriptor (-1 when writev is used)
+        bool                    _fixed;       //!< true if buffers are registered (IORING_OP_WRITE_FIXED)
+        void                   *_sq_ring;     //!< mapped submission ring
+        size_t                  _sq_ring_size;
+        void                   *_cq_ring;     //!< mapped completion ring
+        size_t                  _cq_ring_size;
+        void                   *_sqes;        //!< mapped submission entries
+        size_t                  _sqes_size;
+        unsigned int           *_sq_head;
+        unsigned int           *_sq_tail;
+        unsigned int            _sq_mask;
+        unsigned int           *_sq_array;
+        unsigned int           *_cq_head;
+        unsigned int           *_cq_tail;
+        unsigned int            _cq_mask;
+        void                   *_cqes;
+        unsigned int            _unsubmitted; //!< entries queued but not consumed by the kernel yet
+
+        std::atomic<unsigned long long> _submissions; //!< io_uring_enter or writev calls
+        std::atomic<unsigned long long> _errors;      //!< failed writes
+        std::atomic<unsigned long long> _bytes;       //!< bytes written
+
+        size_t                  _in_flight;   //!< buffers the kernel is writing (protected by _mutex)
+        std::mutex              _mutex;       //!< protects buffer states
+        std::condition_variable _condition;   //!< signaled when a buffer is given back
+        std::thread             _reaper;      //!< reaps the completion queue
+    };
+
+    /** @} */
+
+} // namespace logger
+#endif
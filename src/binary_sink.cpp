@@ -0,0 +1,561 @@
+//
+//  binary_sink.cpp
+//
+
+#include "logger/binary_sink.hpp"
+#include <algorithm> // std::stable_sort
+#include <chrono>
+#include <cstring>   // std::memcpy
+#include <ctime>     // clock_gettime, gmtime_r, localtime_r
+
+namespace logger {
+
+    // record, as staged by the calling thread. It's followed by the encoded arguments (binary records) or by the
+    // rendered message (text records).
+    struct staged_record {
+        char                     kind;       // 'R' binary record, 'T' text record
+        char                     level;      // message's log level
+        char                     scoped;     // 1 if the record starts with the producer's ecid_guard (rendered)
+        char                     padding[5];
+        uint64_t                 timestamp;  // nanoseconds since epoch
+        const format_descriptor *descriptor; // nullptr for text records
+    };
+
+    static uint64_t now() {
+        timespec current{0, 0};
+        clock_gettime(CLOCK_REALTIME, &current);
+
+        return static_cast<uint64_t>(current.tv_sec) * 1000000000ULL + static_cast<uint64_t>(current.tv_nsec);
+    }
+
+    // UTC offset of the local time zone, in seconds
+    static long utc_offset() {
+        time_t current = time(nullptr);
+
+        struct std::tm local_time{0};
+        localtime_r(&current, &local_time);
+
+        struct std::tm utc_time{0};
+        gmtime_r(&current, &utc_time);
+
+        int days = local_time.tm_yday - utc_time.tm_yday;
+        if (days > 1) {
+            days = -1; // local time is still in the previous year
+        } else if (days < -1) {
+            days = 1;  // local time is already in the next year
+        }
+
+        return ((days * 24L + (local_time.tm_hour - utc_time.tm_hour)) * 60L + (local_time.tm_min - utc_time.tm_min)) * 60L;
+    }
+
+    template<typename T> static void put(buffer &out, const T &value) {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    static void put_string(buffer &out, const char *data, size_t size) {
+        put(out, static_cast<uint32_t>(size));
+        out.append(data, size);
+    }
+
+    static void put_string(buffer &out, const std::string &value) {
+        put_string(out, value.data(), value.size());
+    }
+
+    // binary_sink ----------------
+    //
+    binary_sink::binary_sink(FILE *file) :
+            binary_sink("binary-sink", "app", log_level::info, file) {
+    }
+
+    binary_sink::binary_sink(const std::string &name, const std::string &pname, log_level level, FILE *file) :
+            sink(name, pname, level),
+            _file(file),
+            _active(0),
+            _header_dirty(true),
+            _running(true),
+            _sleeping(false) {
+
+        fwrite(BINARY_LOG_MAGIC, 1, strlen(BINARY_LOG_MAGIC), _file);
+
+        _worker = std::thread(&binary_sink::run, this);
+    }
+
+    binary_sink::~binary_sink() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running.store(false);
+        }
+        _condition.notify_one();
+
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+
+        flush();
+    }
+
+    void binary_sink::write(log_level level, const char *fmt, ...) {
+
+        if (level <= this->level()) {
+            va_list args;
+            va_start(args, fmt);
+            {
+                printf_message msg(fmt, args);
+                emit(level, msg);
+            }
+            va_end(args);
+        }
+    }
+
+    void binary_sink::emit(log_level level, const message &msg) {
+
+        if (level > this->level()) {
+            return;
+        }
+
+        static thread_local buffer record;
+        record.clear();
+
+        staged_record header{};
+        header.descriptor = msg.descriptor();
+        header.kind = header.descriptor != nullptr ? 'R' : 'T';
+        header.level = static_cast<char>(level);
+        header.timestamp = now();
+
+        const ecid_guard *guard = ecid_guard::current();
+        header.scoped = guard != nullptr ? 1 : 0;
+
+        put(record, header);
+
+        if (guard != nullptr) {
+            put_string(record, guard->rendered(), guard->rendered_size());
+        }
+
+        if (header.descriptor != nullptr) {
+            msg.encode(record);
+        } else {
+            msg.render(record);
+        }
+
+        staging_ring &ring = _staging.ring();
+        ring.push(record.data(), record.size());
+
+        // don't wait for the next drain, it might be too late.
+        if (ring.half_full() && _sleeping.load(std::memory_order_relaxed)) {
+            _condition.notify_one();
+        }
+    }
+
+    void binary_sink::flush() {
+        drain(true);
+        fflush(_file);
+    }
+
+    unsigned long long binary_sink::dropped() {
+        return _staging.dropped();
+    }
+
+    sink_metrics binary_sink::metrics() {
+        sink_metrics result = sink::metrics();
+        result.dropped += dropped();
+
+        return result;
+    }
+
+    void binary_sink::set_name(const std::string &name) {
+        std::lock_guard<std::mutex> lock(_drain_mutex);
+
+        sink::set_name(name);
+        _header_dirty.store(true);
+    }
+
+    void binary_sink::set_program_name(const std::string &name) {
+        std::lock_guard<std::mutex> lock(_drain_mutex);
+
+        sink::set_program_name(name);
+        _header_dirty.store(true);
+    }
+
+    void binary_sink::run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (_running.load()) {
+            lock.unlock();
+            drain(false);
+            lock.lock();
+
+            if (_running.load()) {
+                _sleeping.store(true);
+                _condition.wait_for(lock, std::chrono::milliseconds(BINARY_SINK_INTERVAL));
+                _sleeping.store(false);
+            }
+        }
+    }
+
+    void binary_sink::drain(bool everything) {
+        std::lock_guard<std::mutex> lock(_drain_mutex);
+
+        buffer &records = _records[_active];
+
+        _staging.for_each([this, &records](staging_ring &ring) {
+            uint64_t thread_id = ring.thread_id();
+
+            ring.drain([this, &records, thread_id](const char *data, size_t size) {
+                staged_record header;
+                memcpy(&header, data, sizeof(header));
+
+                _pending.push_back(pending{header.timestamp, thread_id, records.size(), size});
+                records.append(data, size);
+            });
+        });
+
+        // each thread's records are already ordered, merge them (records kept by the previous drain come first).
+        std::stable_sort(_pending.begin(), _pending.end(), [](const pending &left, const pending &right) {
+            return left.timestamp < right.timestamp;
+        });
+
+        // younger records wait for the next drain. Records stamped after now (the clock went back) don't wait.
+        uint64_t current_time = now();
+        uint64_t cutoff = current_time - static_cast<uint64_t>(BINARY_SINK_INTERVAL) * 1000000;
+        size_t count = _pending.size();
+
+        if (!everything) {
+            for (count = 0; count < _pending.size(); count++) {
+                uint64_t timestamp = _pending[count].timestamp;
+                if (timestamp > cutoff && timestamp <= current_time) {
+                    break;
+                }
+            }
+        }
+
+        _output.clear();
+
+        if (_header_dirty.exchange(false)) {
+            char hostname[HOST_NAME_MAX];
+            hostname[0] = 0;
+            gethostname(hostname, HOST_NAME_MAX);
+
+            _output.append('H');
+            put_string(_output, hostname, strlen(hostname));
+            put_string(_output, program_name());
+            put_string(_output, name());
+            put(_output, static_cast<int64_t>(utc_offset()));
+            put(_output, static_cast<uint32_t>(getpid()));
+        }
+
+        char ecid[ECID_SIZE];
+        size_t ecid_size = this->ecid(ecid, ECID_SIZE);
+        if (_written_ecid.compare(0, std::string::npos, ecid, ecid_size) != 0) {
+            _written_ecid.assign(ecid, ecid_size);
+
+            _output.append('E');
+            put_string(_output, _written_ecid);
+        }
+
+        for (size_t index = 0; index < count; index++) {
+            const pending &current = _pending[index];
+            const char *data = records.data() + current.offset;
+            staged_record header;
+            memcpy(&header, data, sizeof(header));
+
+            const char *payload = data + sizeof(header);
+            size_t payload_size = current.size - sizeof(header);
+
+            if (header.scoped != 0) {
+                // the producer's thread-scoped ECID only applies to this record
+                uint32_t ecid_size;
+                memcpy(&ecid_size, payload, sizeof(ecid_size));
+
+                _output.append('S');
+                _output.append(payload, sizeof(ecid_size) + ecid_size);
+
+                payload += sizeof(ecid_size) + ecid_size;
+                payload_size -= sizeof(ecid_size) + ecid_size;
+            }
+
+            if (header.kind == 'R') {
+                auto found = _dictionary.find(header.descriptor);
+
+                if (found == _dictionary.end()) {
+                    found = _dictionary.emplace(header.descriptor, static_cast<uint32_t>(_dictionary.size())).first;
+
+                    _output.append('D');
+                    put(_output, found->second);
+                    put_string(_output, header.descriptor->format, strlen(header.descriptor->format));
+                    put_string(_output, header.descriptor->types, strlen(header.descriptor->types));
+                }
+
+                _output.append('R');
+                put(_output, found->second);
+                _output.append(header.level);
+                put(_output, current.timestamp);
+                put(_output, current.thread_id);
+                _output.append(payload, payload_size);
+
+            } else {
+                _output.append('T');
+                _output.append(header.level);
+                put(_output, current.timestamp);
+                put(_output, current.thread_id);
+                put_string(_output, payload, payload_size);
+            }
+        }
+
+        // keep the records that were not written in the other buffer
+        buffer &kept = _records[1 - _active];
+        kept.clear();
+
+        _kept.clear();
+        for (size_t index = count; index < _pending.size(); index++) {
+            pending record = _pending[index];
+            kept.append(records.data() + record.offset, record.size);
+            record.offset = kept.size() - record.size;
+            _kept.push_back(record);
+        }
+
+        records.clear();
+        _pending.swap(_kept);
+        _active = 1 - _active;
+
+        if (!_output.empty()) {
+            if (fwrite(_output.data(), 1, _output.size(), _file) == _output.size()) {
+                count_bytes(_output.size());
+            } else {
+                count_errors(1);
+            }
+            count_flush();
+        }
+    }
+
+    // binary_decoder ----------------
+    //
+    binary_decoder::binary_decoder(FILE *file) :
+            _file(file),
+            _pattern(std::string(LOGGER_LOG_PATTERN) + "[L SUBSYS=] "),
+            _scoped(false),
+            _offset(0),
+            _pid(0) {
+
+        char magic[8];
+        if (fread(magic, 1, sizeof(magic), _file) != sizeof(magic) || memcmp(magic, BINARY_LOG_MAGIC, sizeof(magic)) != 0) {
+            throw sink_exception("not a binary log file");
+        }
+    }
+
+    bool binary_decoder::next(buffer &line) {
+        line.clear();
+
+        int tag;
+        while ((tag = fgetc(_file)) != EOF) {
+            switch (tag) {
+                case 'H': {
+                    _hostname = read_string();
+                    _pname = read_string();
+                    _name = read_string();
+
+                    int64_t offset;
+                    read(&offset, sizeof(offset));
+                    _offset = static_cast<long>(offset);
+
+                    uint32_t pid;
+                    read(&pid, sizeof(pid));
+                    _pid = pid;
+
+                    _pattern = std::string(LOGGER_LOG_PATTERN) + "[L SUBSYS=" + _name + "] ";
+                    break;
+                }
+
+                case 'E':
+                    _ecid = read_string();
+                    break;
+
+                case 'S':
+                    _scoped_ecid = read_string();
+                    _scoped = true;
+                    break;
+
+                case 'D': {
+                    uint32_t id;
+                    read(&id, sizeof(id));
+
+                    entry &target = _dictionary[id];
+                    target.format = read_string();
+                    target.types = read_string();
+                    break;
+                }
+
+                case 'R': {
+                    uint32_t id;
+                    read(&id, sizeof(id));
+
+                    auto found = _dictionary.find(id);
+                    if (found == _dictionary.end()) {
+                        throw sink_exception("unknown format string in binary log file");
+                    }
+
+                    char level;
+                    uint64_t timestamp;
+                    uint64_t thread_id;
+                    read(&level, sizeof(level));
+                    read(&timestamp, sizeof(timestamp));
+                    read(&thread_id, sizeof(thread_id));
+
+                    render_header(line, level, timestamp, thread_id);
+                    size_t header_size = line.size();
+
+                    const std::string &fmt = found->second.format;
+                    const std::string &types = found->second.types;
+                    size_t argument = 0;
+
+                    for (size_t pos = 0; pos < fmt.size(); pos++) {
+                        bool escaped = (fmt[pos] == '{' || fmt[pos] == '}') && pos + 1 < fmt.size() && fmt[pos + 1] == fmt[pos];
+
+                        if (escaped) {
+                            line.append(fmt[pos++]);
+                        } else if (fmt[pos] == '{' && pos + 1 < fmt.size() && fmt[pos + 1] == '}') {
+                            if (argument < types.size()) {
+                                render_argument(line, types[argument++]);
+                            }
+                            pos++;
+                        } else {
+                            line.append(fmt[pos]);
+                        }
+                    }
+
+                    if (line.size() == header_size || line.back() != '\n') {
+                        line.append('\n');
+                    }
+                    return true;
+                }
+
+                case 'T': {
+                    char level;
+                    uint64_t timestamp;
+                    uint64_t thread_id;
+                    read(&level, sizeof(level));
+                    read(&timestamp, sizeof(timestamp));
+                    read(&thread_id, sizeof(thread_id));
+
+                    render_header(line, level, timestamp, thread_id);
+                    size_t header_size = line.size();
+
+                    line.append(read_string());
+
+                    if (line.size() == header_size || line.back() != '\n') {
+                        line.append('\n');
+                    }
+                    return true;
+                }
+
+                default:
+                    throw sink_exception("corrupted binary log file");
+            }
+        }
+
+        return false;
+    }
+
+    void binary_decoder::read(void *target, size_t size) {
+        if (fread(target, 1, size, _file) != size) {
+            throw sink_exception("truncated binary log file");
+        }
+    }
+
+    std::string binary_decoder::read_string() {
+        uint32_t size;
+        read(&size, sizeof(size));
+
+        std::string result(size, '\0');
+        if (size > 0) {
+            read(&result[0], size);
+        }
+
+        return result;
+    }
+
+    void binary_decoder::render_header(buffer &line, int level, uint64_t timestamp, uint64_t thread_id) {
+        auto seconds = static_cast<time_t>(timestamp / 1000000000ULL + _offset);
+        auto micros = static_cast<long>((timestamp % 1000000000ULL) / 1000);
+
+        struct std::tm local_time{0};
+        gmtime_r(&seconds, &local_time);
+
+        long lag = (_offset < 0 ? -_offset : _offset) / 60;
+
+        char now[DATE_TIME_SIZE];
+        int length = snprintf(now, DATE_TIME_SIZE, "%d-%02d-%02dT%02d:%02d:%02d.%06ld%s%02ld:%02ld",
+                 local_time.tm_year + 1900,
+                 local_time.tm_mon + 1,
+                 local_time.tm_mday,
+                 local_time.tm_hour,
+                 local_time.tm_min,
+                 local_time.tm_sec,
+                 micros,
+                 _offset < 0 ? "-" : "+",
+                 lag / 60,
+                 lag % 60);
+        if (length < 0 || static_cast<size_t>(length) >= DATE_TIME_SIZE) {
+            strcpy(now, "-"); // corrupted timestamp, RFC5424's nil value rather than a truncated date
+        }
+
+        line.printf(
+                _pattern.c_str(),
+                level,
+                now,
+                _hostname.c_str(),
+                _pname.c_str(),
+                static_cast<int>(_pid),
+                static_cast<int>(thread_id),
+                _scoped ? _scoped_ecid.c_str() : (_ecid.empty() ? "- " : _ecid.c_str())
+        );
+
+        _scoped = false; // a thread-scoped ECID only applies to one record
+    }
+
+    void binary_decoder::render_argument(buffer &line, char type) {
+        switch (type) {
+            case 'i': {
+                int64_t value;
+                read(&value, sizeof(value));
+                line.printf("%lld", static_cast<long long>(value));
+                break;
+            }
+            case 'u': {
+                uint64_t value;
+                read(&value, sizeof(value));
+                line.printf("%llu", static_cast<unsigned long long>(value));
+                break;
+            }
+            case 'd': {
+                double value;
+                read(&value, sizeof(value));
+                line.printf("%g", value);
+                break;
+            }
+            case 'p': {
+                uint64_t value;
+                read(&value, sizeof(value));
+                line.printf("%p", reinterpret_cast<void *>(static_cast<uintptr_t>(value)));
+                break;
+            }
+            case 'c': {
+                char value;
+                read(&value, sizeof(value));
+                line.append(value);
+                break;
+            }
+            case 'b': {
+                char value;
+                read(&value, sizeof(value));
+                line.append(value != 0 ? "true" : "false");
+                break;
+            }
+            case 's':
+                line.append(read_string());
+                break;
+            default:
+                throw sink_exception("unknown argument type in binary log file");
+        }
+    }
+
+} // namespace logger
@@ -0,0 +1,69 @@
+//
+//  buffer.cpp
+//
+
+#include "logger/buffer.hpp"
+#include <cstdio>  // std::vsnprintf(...)
+#include <cstring> // std::memcpy
+
+namespace logger {
+
+    buffer::buffer(size_t capacity) :
+            _data(new char[capacity + 1]),
+            _size(0),
+            _capacity(capacity) {
+        _data[0] = 0;
+    }
+
+    void buffer::append(const char *data, size_t size) {
+        if (_size + size > _capacity) {
+            reserve(_size + size);
+        }
+
+        memcpy(_data.get() + _size, data, size);
+        _size += size;
+        _data[_size] = 0;
+    }
+
+    void buffer::printf(const char *fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        vprintf(fmt, args);
+        va_end(args);
+    }
+
+    void buffer::vprintf(const char *fmt, va_list args) {
+        va_list retry;
+        va_copy(retry, args); // in case the buffer is too small
+
+        // vsnprintf returns the number of characters the whole output needs (not counting the ending \0).
+        int needed = vsnprintf(_data.get() + _size, _capacity - _size + 1, fmt, args);
+
+        if (needed > 0) {
+            if (static_cast<size_t>(needed) > _capacity - _size) {
+                reserve(_size + needed);
+                vsnprintf(_data.get() + _size, _capacity - _size + 1, fmt, retry);
+            }
+            _size += needed;
+        }
+
+        _data[_size] = 0;
+        va_end(retry);
+    }
+
+    void buffer::reserve(size_t capacity) {
+        if (capacity > _capacity) {
+            size_t target = _capacity * 2;
+            if (target < capacity) {
+                target = capacity;
+            }
+
+            std::unique_ptr<char[]> data(new char[target + 1]);
+            memcpy(data.get(), _data.get(), _size + 1);
+
+            _data.swap(data);
+            _capacity = target;
+        }
+    }
+
+} // namespace logger
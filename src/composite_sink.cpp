@@ -0,0 +1,179 @@
+//
+//  composite_sink.cpp
+//
+
+#include "logger/composite_sink.hpp"
+#include "logger/probes.hpp"
+#include <cstring> // std::strcmp
+
+namespace logger {
+
+    // what children receive: the message rendered by the composite, structured data is still available to the sinks
+    // that render it their own way (see json_file_sink)
+    class rendered_message : public message {
+    public:
+        rendered_message(const buffer &text, const message &msg) : _text(text), _message(msg) {
+            // intentional...
+        }
+
+        void render(buffer &out) const override {
+            out.append(_text.data(), _text.size());
+        }
+
+        const format_descriptor *descriptor() const override {
+            return _message.descriptor();
+        }
+
+        void encode(buffer &out) const override {
+            _message.encode(out);
+        }
+
+        void render_text(buffer &out) const override {
+            _message.render_text(out);
+        }
+
+        const field *fields(size_t &count) const override {
+            return _message.fields(count);
+        }
+
+        double sampling_rate() const override {
+            return _message.sampling_rate();
+        }
+
+    private:
+        const buffer  &_text;
+        const message &_message;
+    };
+
+    composite_sink::composite_sink(const std::string &name, const std::string &pname, log_level level) :
+            sink(name, pname, level) {
+        // intentional...
+    }
+
+    composite_sink::composite_sink() :
+            composite_sink("default", "pname", log_level::trace) {
+        // intentional...
+    }
+
+    composite_sink &composite_sink::add(sink *target) {
+        if (target == nullptr) {
+            throw sink_exception("composite_sink children can't be null");
+        }
+        if (dynamic_cast<composite_sink *>(target) != nullptr) {
+            delete target;
+            throw sink_exception("composite_sink children can't be composite sinks");
+        }
+
+        target->set_name(name());
+        target->set_program_name(program_name());
+
+        child added{std::unique_ptr<sink>(target), dynamic_cast<file_sink *>(target)};
+
+        // file sinks that share a layout are kept next to each other, so that a rendered line is reused right away
+        auto position = _children.end();
+        if (added.file != nullptr) {
+            for (auto current = _children.begin(); current != _children.end(); ++current) {
+                if (current->file != nullptr && strcmp(current->file->layout(), added.file->layout()) == 0) {
+                    position = current + 1;
+                }
+            }
+        }
+        _children.insert(position, std::move(added));
+
+        return *this;
+    }
+
+    void composite_sink::flush() {
+        for (auto &current : _children) {
+            if (current.file != nullptr) {
+                current.file->flush();
+            } else if (auto syslog = dynamic_cast<syslog_sink *>(current.target.get())) {
+                syslog->flush();
+            }
+        }
+    }
+
+    void composite_sink::write(log_level level, const char *fmt, ...) {
+        if (level <= this->level()) {
+            va_list args;
+            va_start(args, fmt);
+            {
+                printf_message msg(fmt, args);
+                emit(level, msg);
+            }
+            va_end(args);
+        }
+    }
+
+    void composite_sink::emit(log_level level, const message &msg) {
+        if (level > this->level()) {
+            return;
+        }
+
+        // the message is rendered once per call, and each layout's line at most once
+        static thread_local buffer text;
+        static thread_local buffer line;
+        text.clear();
+        msg.render(text);
+
+        rendered_message rendered(text, msg);
+        const char *rendered_layout = nullptr;
+
+        for (auto &current : _children) {
+            if (level > current.target->level()) {
+                continue;
+            }
+
+            if (current.file == nullptr) {
+                current.target->emit(level, rendered);
+                continue;
+            }
+
+            const char *layout = current.file->layout();
+            if (rendered_layout == nullptr || strcmp(rendered_layout, layout) != 0) {
+                line.clear();
+                current.file->render_line(level, rendered, line);
+                CPP_LOGGER_PROBE(formatted, level, name().c_str(), line.size());
+                rendered_layout = layout;
+            }
+
+            current.file->output(level, line.data(), line.size());
+            CPP_LOGGER_PROBE(written, level, name().c_str(), line.size());
+        }
+    }
+
+    void composite_sink::set_ecid(const std::string &ecid) {
+        sink::set_ecid(ecid);
+
+        for (auto &current : _children) {
+            current.target->set_ecid(ecid);
+        }
+    }
+
+    sink_metrics composite_sink::metrics() {
+        sink_metrics result = sink::metrics();
+
+        for (auto &current : _children) {
+            result += current.target->metrics();
+        }
+
+        return result;
+    }
+
+    void composite_sink::set_name(const std::string &name) {
+        sink::set_name(name);
+
+        for (auto &current : _children) {
+            current.target->set_name(name);
+        }
+    }
+
+    void composite_sink::set_program_name(const std::string &name) {
+        sink::set_program_name(name);
+
+        for (auto &current : _children) {
+            current.target->set_program_name(name);
+        }
+    }
+
+} // namespace logger
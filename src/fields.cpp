@@ -0,0 +1,67 @@
+//
+//  fields.cpp
+//
+
+#include "logger/fields.hpp"
+#include <cstring> // std::strlen
+
+namespace logger {
+
+    // append an SD-NAME: printable US-ASCII except '=', ' ', ']' and '"', 32 characters at most
+    static void append_name(buffer &out, const char *name) {
+        size_t size = 0;
+
+        for (; name != nullptr && name[size] != 0 && size < FIELD_NAME_SIZE; size++) {
+            char c = name[size];
+            out.append(c > ' ' && c < 127 && c != '=' && c != ']' && c != '"' ? c : '_');
+        }
+
+        if (size == 0) {
+            out.append('_');
+        }
+    }
+
+    // append a PARAM-VALUE, '"', '\' and ']' are escaped with a backslash
+    static void append_value(buffer &out, const char *value, size_t size) {
+        size_t begin = 0;
+
+        for (size_t pos = 0; pos < size; pos++) {
+            char c = value[pos];
+            if (c == '"' || c == '\\' || c == ']') {
+                out.append(value + begin, pos - begin);
+                out.append('\\');
+                begin = pos;
+            }
+        }
+
+        out.append(value + begin, size - begin);
+    }
+
+    void fields_message::render(buffer &out) const {
+        static thread_local buffer scratch;
+
+        out.append("[F", 2);
+        for (size_t index = 0; index < _count; index++) {
+            const field &current = _fields[index];
+
+            scratch.clear();
+            current.writer(scratch, current.value);
+
+            out.append(' ');
+            append_name(out, current.key);
+            out.append("=\"", 2);
+            append_value(out, scratch.data(), scratch.size());
+            out.append('"');
+        }
+        out.append("] ", 2);
+
+        render_text(out);
+    }
+
+    void fields_message::render_text(buffer &out) const {
+        if (_text != nullptr) {
+            out.append(_text, strlen(_text));
+        }
+    }
+
+} // namespace logger
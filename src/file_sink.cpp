@@ -5,31 +5,66 @@
 
 #include <sys/time.h>
 #include "logger/sinks.hpp"
+#include "logger/uring_writer.hpp"
+#include "logger/format.hpp"
+#include "logger/thread_info.hpp"
+#include "logger/probes.hpp"
 #include <cstring>
+#include <algorithm> // std::find
+#include <pthread.h> // pthread_atfork
+#include <new>       // placement new
 
 namespace logger {
 
+    // file sinks alive in this process, their header must be rendered again in a forked child (new process ID).
+    // Intentionally leaked: sinks held by static loggers can be destroyed after this would be.
+    struct live_file_sinks {
+        std::mutex               mutex;
+        std::vector<file_sink *> sinks;
+    };
+
+    static live_file_sinks &live_sinks() {
+        static live_file_sinks *sinks = new live_file_sinks;
+        return *sinks;
+    }
+
 
     file_sink::file_sink(FILE *file) :
       file_sink("file-sink", "app", log_level::info, file){
     }
 
+    file_sink::file_sink(FILE *file, const flush_policy &policy) :
+      file_sink("file-sink", "app", log_level::info, file, policy){
+    }
+
     file_sink::file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file) :
+      file_sink(name, pname, level, file, flush_policy()){
+    }
+
+    file_sink::file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file, const flush_policy &policy) :
             sink(name, pname, level),
             _file_descriptor(file),
+            _policy(policy),
+            _pending(policy.backend == io_backend::stdio ? policy.buffer_size * 1024 : 0),
+            _buffer_full_flushes(0),
+            _timer_flushes(0),
+            _level_flushes(0),
+            _requested_flushes(0),
+            _bytes(0),
+            _stopping(false),
             _pid(getpid()) {
 #ifdef DEBUG
-        printf ("DEBUG %s pattern: [%s](%s,%d)\n", __FUNCTION__, _pattern.c_str(), __FILE__, __LINE__);
+        printf ("DEBUG %s name: [%s](%s,%d)\n", __FUNCTION__, name.c_str(), __FILE__, __LINE__);
 #endif
 
-        // this will set sink's name and set/reset the static part of the messages this sink will produce.
-        set_name(name);
-
         char hostname[HOST_NAME_MAX];
         hostname[0] = 0;
         gethostname(hostname, HOST_NAME_MAX);
         _hostname = hostname;
 
+        // this will set sink's name and set/reset the static part of the messages this sink will produce.
+        set_name(name);
+
         timeval current_time{0};
         gettimeofday(&current_time, nullptr);
 
@@ -48,22 +83,159 @@ namespace logger {
                  minutes
         );
         _lag = buffer;
+
+        if (_policy.backend != io_backend::stdio && file != nullptr) {
+            // what's already in the FILE must be written before the backend's lines
+            fflush(file);
+
+            // without buffering, each line is written before output() returns: io_uring can't save the caller anything
+            io_backend backend = _policy.buffer_size > 0 ? _policy.backend : io_backend::writev;
+            _writer.reset(new uring_writer(fileno(file), _policy.buffer_size > 0 ? _policy.buffer_size * 1024 : 64 * 1024, backend));
+        }
+
+        if (_policy.buffer_size > 0 && _policy.interval > 0) {
+            _timer = std::thread(&file_sink::run_timer, this);
+        }
+
+        // last, a sink which constructor throws is never registered
+        static std::once_flag fork_handlers;
+        std::call_once(fork_handlers, []() {
+            // the output mutexes are locked too, the child must not inherit one held by a thread it doesn't have
+            pthread_atfork(
+                    []() {
+                        live_sinks().mutex.lock();
+                        for (auto current : live_sinks().sinks) {
+                            current->_output_mutex.lock();
+                        }
+                    },
+                    []() {
+                        for (auto current : live_sinks().sinks) {
+                            current->_output_mutex.unlock();
+                        }
+                        live_sinks().mutex.unlock();
+                    },
+                    &file_sink::after_fork);
+        });
+
+        std::lock_guard<std::mutex> lock(live_sinks().mutex);
+        live_sinks().sinks.push_back(this);
     };
 
+    file_sink::~file_sink() {
+        {
+            std::lock_guard<std::mutex> lock(live_sinks().mutex);
+            auto &sinks = live_sinks().sinks;
+            sinks.erase(std::find(sinks.begin(), sinks.end(), this));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_output_mutex);
+            _stopping = true;
+        }
+        _timer_condition.notify_one();
+
+        if (_timer.joinable()) {
+            _timer.join();
+        }
+
+        std::lock_guard<std::mutex> lock(_output_mutex);
+        if (!_pending.empty()) {
+            flush_pending(_requested_flushes);
+        }
+
+        if (_writer) {
+            _writer->wait();
+        }
+    }
+
+    void file_sink::flush() {
+        std::lock_guard<std::mutex> lock(_output_mutex);
+        flush_pending(_requested_flushes);
+
+        if (_writer) {
+            _writer->wait();
+        }
+    }
+
+    io_backend file_sink::backend() const {
+        return _writer ? _writer->backend() : io_backend::stdio;
+    }
+
+    sink_metrics file_sink::metrics() {
+        sink_metrics result = sink::metrics();
+
+        // the writer knows what reached the file, lines are only copied into its buffers by output()
+        if (_writer) {
+            result.bytes += _writer->bytes();
+            result.errors += _writer->errors();
+        }
+
+        return result;
+    }
+
+    flush_counters file_sink::counters() const {
+        return flush_counters{
+                _buffer_full_flushes.load(std::memory_order_relaxed),
+                _timer_flushes.load(std::memory_order_relaxed),
+                _level_flushes.load(std::memory_order_relaxed),
+                _requested_flushes.load(std::memory_order_relaxed),
+                _bytes.load(std::memory_order_relaxed)
+        };
+    }
+
     void file_sink::set_name(const std::string &name) {
         sink::set_name(name);
+        render_header();
+    }
+
+    void file_sink::set_program_name(const std::string &name) {
+        sink::set_program_name(name);
+        render_header();
+    }
+
+    void file_sink::render_header() {
+        _header = _hostname + " " + program_name() + "." + std::to_string(_pid) + ".";
+        _subsystem = "[L SUBSYS=" + name() + "] ";
+    }
 
-        _pattern = std::string(LOGGER_LOG_PATTERN) + "[L SUBSYS=" + name + "] %s";
+    void file_sink::after_fork() {
+        // only the forking thread runs in the child, the mutexes were locked by the prepare handler
+        for (auto current : live_sinks().sinks) {
+            current->_pid = getpid();
+            current->render_header();
+
+            // the timer thread wasn't forked: its handle and the condition it was waiting on are abandoned (neither
+            // can be joined nor destroyed) and a new timer is started in their place.
+            if (current->_timer.joinable()) {
+                new (&current->_timer_condition) std::condition_variable;
+                new (&current->_timer) std::thread(&file_sink::run_timer, current);
+            }
+            current->_output_mutex.unlock();
+        }
+        live_sinks().mutex.unlock();
     }
 
     void file_sink::write(log_level level, const char *fmt, ...) {
+
+        if (level <= this->level()) {
+            va_list args;
+            va_start(args, fmt);
+            {
+                printf_message msg(fmt, args);
+                emit(level, msg);
+            }
+            va_end(args);
+        }
+    }; // write
+
+    void file_sink::emit(log_level level, const message &msg) {
 #ifdef DEBUG
-        printf("DEBUG %s _level/level: %d/%d, level name: %s, pattern: [%s] (%s,%d)\n",
+        printf("DEBUG %s _level/level: %d/%d, level name: %s, subsystem: [%s] (%s,%d)\n",
             __FUNCTION__,
-            level(),
+            this->level(),
             level,
             log_level_name(level).c_str(),
-            _pattern.c_str(),
+            _subsystem.c_str(),
             __FILE__,__LINE__);
 #endif
 
@@ -71,87 +243,221 @@ namespace logger {
 
         if (target_level >= level) {
 
-            // fill a buffer with the user message
-            va_list args1;
-            va_list args2;
+            // each thread renders its lines in its own buffer. Once the buffer is big enough, no more heap
+            // allocation is needed.
+            static thread_local buffer line;
+            line.clear();
+
+            render_line(level, msg, line);
+            CPP_LOGGER_PROBE(formatted, level, name().c_str(), line.size());
+
+            output(level, line.data(), line.size());
+            CPP_LOGGER_PROBE(written, level, name().c_str(), line.size());
+        }
+    }; // emit
+
+    void file_sink::render_line(log_level level, const message &msg, buffer &line) {
+        static const char padding[] = "                ";
+        static const size_t ecid_width = sizeof(padding) - 1;
+
+        char now[DATE_TIME_SIZE];
+        size_t now_size = date_time(now, DATE_TIME_SIZE);
 
-            va_start(args1, fmt); // initialize va_list
-            va_copy(args2, args1); // save a copy args1 -> args2
+        char ecid[ECID_SIZE];
+        size_t ecid_size = this->ecid(ecid, ECID_SIZE); // we use ecid's accessor because access needs to be threadsafe
 
-            // new character vector
-            // vsnprintf returns the needed characters to store the output
-            //NOSONAR not possible with XL C/C++ std::vector<char> buf(1+std::vsnprintf(NULL, 0, fmt, args1));
+        // header, same layout as LOGGER_LOG_PATTERN: <level>1 date-time host program.pid.thread - ecid [L SUBSYS=name]
+        line.append('<');
+        format_value(line, static_cast<int>(level));
+        line.append(">1 ", 3);
+        line.append(now, now_size);
+        line.append(' ');
+        line.append(_header.data(), _header.size());
+        const thread_info &thread = current_thread();
+        line.append(thread.rendered_id, thread.rendered_id_size);
+        line.append(" - ", 3);
 
-            // this call only returns the actual number of bytes needed to store the message.
-            // It doesn't count the needed end-of-string
-            size_t buffer_size = vsnprintf(nullptr, 0, fmt, args1) + 1; // plus 1 character to store \0
-            va_end(args1); // don't need this one anymore
+        if (ecid_size == 0) {
+            ecid[0] = '-';
+            ecid[1] = ' ';
+            ecid_size = 2;
+        }
+        line.append(ecid, ecid_size);
+        if (ecid_size < ecid_width) {
+            line.append(padding, ecid_width - ecid_size);
+        }
+        line.append(_subsystem.data(), _subsystem.size());
 
-            // add one more character to handle \n (see code below)
-            char buffer[buffer_size + 1];
-            memset(buffer, 0, buffer_size + 1);
+        size_t header_size = line.size();
 
-            // fill buffer with message ...
-            vsnprintf(buffer, buffer_size, fmt, args2);
-            size_t len = strlen(buffer);
-            va_end(args2);
+        // user message
+        msg.render(line);
 
 #ifdef DEBUG
-            printf ("DEBUG pattern: [%s], file: %d\nDEBUG found end-of-line character in [%s]: %s (%s,%d)\n",
-                _pattern.c_str(),
-                _file_descriptor,
-                buffer,
-                buffer[len-1] == '\n' ? "yes" : "no",
-                __FILE__,
-                __LINE__);
+        printf ("DEBUG subsystem: [%s], file: %d\nDEBUG found end-of-line character in [%s]: %s (%s,%d)\n",
+            _subsystem.c_str(),
+            _file_descriptor,
+            line.data(),
+            line.back() == '\n' ? "yes" : "no",
+            __FILE__,
+            __LINE__);
 #endif
-            // add a new line if not already there
-            if (buffer[len - 1] != '\n') {
-                buffer[len] = '\n'; // override ending \0 (that's why we provisioned for one more character above)
+        // add a new line if not already there
+        if (line.size() == header_size || line.back() != '\n') {
+            line.append('\n');
+        }
+    }
+
+    void file_sink::output(log_level level, const char *data, size_t size) {
+        bool severe = level <= _policy.level;
+
+        if (_writer) {
+            std::lock_guard<std::mutex> lock(_output_mutex);
+            _bytes.fetch_add(size, std::memory_order_relaxed);
+
+            if (_writer->append(data, size)) {
+                _buffer_full_flushes.fetch_add(1, std::memory_order_relaxed);
             }
 
-            std::string ecid = this->ecid(); // we use ecid's accessor because access needs to be threadsafe
-
-            fprintf(
-                    _file_descriptor,
-                    _pattern.c_str(),
-                    target_level,
-                    date_time().c_str(),
-                    _hostname.c_str(),
-                    program_name().c_str(),
-                    _pid,
-                    std::this_thread::get_id(),
-                    ecid.empty() ? "- " : ecid.c_str(),
-                    buffer
-            );
+            // without buffering, each line is written right away (the writer uses writev, see the constructor)
+            if (severe) {
+                flush_pending(_level_flushes);
+            } else if (_policy.buffer_size == 0) {
+                _writer->submit();
+            }
+            return;
+        }
+
+        if (_policy.buffer_size == 0) {
+            // no buffering, the line goes straight to the FILE (which has its own lock)
+            if (fwrite(data, 1, size, _file_descriptor) == size) {
+                count_bytes(size);
+            } else {
+                count_errors(1);
+            }
+            _bytes.fetch_add(size, std::memory_order_relaxed);
+
+            if (severe) {
+                if (fflush(_file_descriptor) != 0) {
+                    count_errors(1);
+                }
+                count_flush();
+                _level_flushes.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        size_t capacity = _policy.buffer_size * 1024;
+        std::lock_guard<std::mutex> lock(_output_mutex);
+
+        // lines are never split, make room first
+        if (!_pending.empty() && _pending.size() + size > capacity) {
+            flush_pending(_buffer_full_flushes);
+        }
+
+        _pending.append(data, size);
+
+        if (severe) {
+            flush_pending(_level_flushes);
+        } else if (_pending.size() >= capacity) {
+            flush_pending(_buffer_full_flushes);
+        }
+    }
+
+    void file_sink::flush_pending(std::atomic<unsigned long long> &counter) {
+        if (_writer) {
+            _writer->submit();
+            count_flush();
+            counter.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
-    }; // write
+
+        if (!_pending.empty()) {
+            if (fwrite(_pending.data(), 1, _pending.size(), _file_descriptor) == _pending.size()) {
+                count_bytes(_pending.size());
+            } else {
+                count_errors(1);
+            }
+            _bytes.fetch_add(_pending.size(), std::memory_order_relaxed);
+            _pending.clear();
+        }
+
+        if (_file_descriptor != nullptr && fflush(_file_descriptor) != 0) {
+            count_errors(1);
+        }
+        count_flush();
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void file_sink::run_timer() {
+        std::unique_lock<std::mutex> lock(_output_mutex);
+
+        while (!_stopping) {
+            _timer_condition.wait_for(lock, std::chrono::milliseconds(_policy.interval));
+
+            if (!_stopping && (!_pending.empty() || (_writer && _writer->pending() > 0))) {
+                flush_pending(_timer_flushes);
+            }
+        }
+    }
 
     const std::string file_sink::date_time() {
-        int size = 50;
-        char buffer[size];
-        char target[size];
+        char target[DATE_TIME_SIZE];
+
+        return std::string(target, date_time(target, DATE_TIME_SIZE));
+    }
 
-        memset(buffer, 0, size);
-        memset(target, 0, size);
+    size_t file_sink::date_time(char *target, size_t size) {
+
+        // Most messages are written during the same second as the previous one. Therefore, each thread keeps the date
+        // and time part (YYYY-MM-DDTHH:MM:SS.) of the last second it used, and only the microseconds are rendered on
+        // each call.
+        struct cache {
+            time_t seconds;
+            size_t length;
+            char   prefix[DATE_TIME_SIZE];
+        };
+        static thread_local cache current{-1, 0, {0}};
 
         timeval current_time{0};
         gettimeofday(&current_time, nullptr);
-        int micros = current_time.tv_usec;
 
-        struct std::tm local_time{0};
-        localtime_r(&current_time.tv_sec, &local_time);
-        snprintf(target, size - 1, "%d-%02d-%02dT%02d:%02d:%02d.%06d%s",
-                 local_time.tm_year + 1900, // tm_year is the number of years from 1900
-                 local_time.tm_mon + 1,   // tm_mon is the month number starting from 0
-                 local_time.tm_mday,
-                 local_time.tm_hour,
-                 local_time.tm_min,
-                 local_time.tm_sec,
-                 micros,
-                 _lag.c_str());
-
-        return std::string(target);
+        if (current_time.tv_sec != current.seconds) {
+            struct std::tm local_time{0};
+            localtime_r(&current_time.tv_sec, &local_time);
+
+            int length = snprintf(current.prefix, DATE_TIME_SIZE, "%d-%02d-%02dT%02d:%02d:%02d.",
+                     local_time.tm_year + 1900, // tm_year is the number of years from 1900
+                     local_time.tm_mon + 1,   // tm_mon is the month number starting from 0
+                     local_time.tm_mday,
+                     local_time.tm_hour,
+                     local_time.tm_min,
+                     local_time.tm_sec);
+
+            current.length = length > 0 ? static_cast<size_t>(length) : 0;
+            current.seconds = current_time.tv_sec;
+        }
+
+        size_t length = current.length + 6 + _lag.size(); // prefix + microseconds + lag
+
+        if (length >= size) {
+            target[0] = 0;
+            return 0;
+        }
+
+        memcpy(target, current.prefix, current.length);
+
+        // render the microseconds digits from right to left (always 6 digits)
+        auto micros = static_cast<long>(current_time.tv_usec);
+        for (char *digit = target + current.length + 5; digit >= target + current.length; digit--) {
+            *digit = static_cast<char>('0' + (micros % 10));
+            micros /= 10;
+        }
+
+        memcpy(target + current.length + 6, _lag.c_str(), _lag.size());
+        target[length] = 0;
+
+        return length;
     }
 
 } // namespace logger
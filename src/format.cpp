@@ -0,0 +1,93 @@
+//
+//  format.cpp
+//
+
+#include "logger/format.hpp"
+#include <cstdio>  // std::snprintf(...)
+#include <cstring> // std::strlen
+
+namespace logger {
+
+    void format_value(buffer &out, const char *value) {
+        if (value == nullptr) {
+            out.append("(null)", 6);
+        } else {
+            out.append(value, strlen(value));
+        }
+    }
+
+    void format_value(buffer &out, const std::string &value) {
+        out.append(value);
+    }
+
+    void format_value(buffer &out, char value) {
+        out.append(value);
+    }
+
+    void format_value(buffer &out, bool value) {
+        if (value) {
+            out.append("true", 4);
+        } else {
+            out.append("false", 5);
+        }
+    }
+
+    void format_value(buffer &out, int value) {
+        format_value(out, static_cast<long long>(value));
+    }
+
+    void format_value(buffer &out, long value) {
+        format_value(out, static_cast<long long>(value));
+    }
+
+    void format_value(buffer &out, long long value) {
+        if (value < 0) {
+            out.append('-');
+            // negate as unsigned, -LLONG_MIN doesn't fit in a long long
+            format_value(out, 0ULL - static_cast<unsigned long long>(value));
+        } else {
+            format_value(out, static_cast<unsigned long long>(value));
+        }
+    }
+
+    void format_value(buffer &out, unsigned int value) {
+        format_value(out, static_cast<unsigned long long>(value));
+    }
+
+    void format_value(buffer &out, unsigned long value) {
+        format_value(out, static_cast<unsigned long long>(value));
+    }
+
+    void format_value(buffer &out, unsigned long long value) {
+        char digits[20]; // enough for 2^64 - 1
+        char *end = digits + sizeof(digits);
+        char *first = end;
+
+        // render digits from right to left
+        do {
+            *--first = static_cast<char>('0' + (value % 10));
+            value /= 10;
+        } while (value != 0);
+
+        out.append(first, end - first);
+    }
+
+    void format_value(buffer &out, double value) {
+        char digits[32];
+        int size = snprintf(digits, sizeof(digits), "%g", value);
+
+        if (size > 0) {
+            out.append(digits, static_cast<size_t>(size) < sizeof(digits) ? size : sizeof(digits) - 1);
+        }
+    }
+
+    void format_value(buffer &out, const void *value) {
+        char digits[32];
+        int size = snprintf(digits, sizeof(digits), "%p", value);
+
+        if (size > 0) {
+            out.append(digits, static_cast<size_t>(size) < sizeof(digits) ? size : sizeof(digits) - 1);
+        }
+    }
+
+} // namespace logger
@@ -0,0 +1,169 @@
+//
+//  json_sink.cpp
+//
+
+#include "logger/json_sink.hpp"
+#include "logger/fields.hpp"
+#include "logger/thread_info.hpp"
+#include <cstring> // std::strlen
+
+namespace logger {
+
+    static const char *const level_names[] = {"emerg", "alert", "crit", "err", "warning", "notice", "info", "debug", "trace"};
+
+    // append a JSON string's characters: '"', '\' and control characters are escaped, other bytes are copied (UTF-8)
+    static void append_escaped(buffer &out, const char *data, size_t size) {
+        static const char digits[] = "0123456789abcdef";
+        size_t begin = 0;
+
+        for (size_t pos = 0; pos < size; pos++) {
+            auto c = static_cast<unsigned char>(data[pos]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+
+            out.append(data + begin, pos - begin);
+            begin = pos + 1;
+
+            switch (c) {
+                case '"':  out.append("\\\"", 2); break;
+                case '\\': out.append("\\\\", 2); break;
+                case '\n': out.append("\\n", 2); break;
+                case '\r': out.append("\\r", 2); break;
+                case '\t': out.append("\\t", 2); break;
+                default: {
+                    char escaped[] = {'\\', 'u', '0', '0', digits[c >> 4], digits[c & 0xF]};
+                    out.append(escaped, sizeof(escaped));
+                }
+            }
+        }
+
+        out.append(data + begin, size - begin);
+    }
+
+    // append a member name and its string value
+    static void append_member(buffer &out, const char *name, const char *value, size_t size) {
+        out.append(',');
+        out.append('"');
+        out.append(name, strlen(name));
+        out.append("\":\"", 3);
+        append_escaped(out, value, size);
+        out.append('"');
+    }
+
+    json_file_sink::json_file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file) :
+            file_sink(name, pname, level, file) {
+        // intentional...
+    }
+
+    json_file_sink::json_file_sink(const std::string &name, const std::string &pname, log_level level, FILE *file, const flush_policy &policy) :
+            file_sink(name, pname, level, file, policy) {
+        // intentional...
+    }
+
+    json_file_sink::json_file_sink(FILE *file) :
+            file_sink(file) {
+        // intentional...
+    }
+
+    json_file_sink::json_file_sink(FILE *file, const flush_policy &policy) :
+            file_sink(file, policy) {
+        // intentional...
+    }
+
+    void json_file_sink::render_line(log_level level, const message &msg, buffer &line) {
+        // the message's text and field values go through the calling thread's scratch buffer
+        static thread_local buffer text;
+
+        char now[DATE_TIME_SIZE];
+        size_t now_size = date_time(now, DATE_TIME_SIZE);
+
+        line.append("{\"timestamp\":\"", 14);
+        line.append(now, now_size);
+        line.append('"');
+
+        const char *level_name = level >= 0 && level <= LOG_TRACE ? level_names[level] : "unknown";
+        append_member(line, "level", level_name, strlen(level_name));
+        append_member(line, "hostname", hostname().data(), hostname().size());
+        append_member(line, "program", program_name().data(), program_name().size());
+
+        line.append(",\"pid\":", 7);
+        format_value(line, static_cast<long>(pid()));
+        const thread_info &thread = current_thread();
+        line.append(",\"tid\":", 7);
+        line.append(thread.rendered_id, thread.rendered_id_size);
+        if (thread.name_size > 0) {
+            append_member(line, "thread", thread.name, thread.name_size);
+        }
+
+        append_member(line, "subsystem", name().data(), name().size());
+
+        // the ECID is stored rendered, [M ECID="..."]
+        static const size_t prefix_size = strlen("[M ECID=\"");
+        char ecid[ECID_SIZE];
+        size_t ecid_size = this->ecid(ecid, ECID_SIZE);
+
+        if (ecid_size > prefix_size + 2) {
+            append_member(line, "ecid", ecid + prefix_size, ecid_size - prefix_size - 2);
+        } else {
+            line.append(",\"ecid\":null", 12);
+        }
+
+        text.clear();
+        msg.render_text(text);
+
+        size_t text_size = text.size();
+        while (text_size > 0 && text.data()[text_size - 1] == '\n') {
+            text_size--;
+        }
+        append_member(line, "message", text.data(), text_size);
+
+        size_t count = 0;
+        const field *fields = msg.fields(count);
+
+        if (count > 0) {
+            line.append(",\"fields\":{", 11);
+            for (size_t index = 0; index < count; index++) {
+                if (index > 0) {
+                    line.append(',');
+                }
+
+                line.append('"');
+                append_escaped(line, fields[index].key, fields[index].key != nullptr ? strlen(fields[index].key) : 0);
+                line.append("\":\"", 3);
+
+                text.clear();
+                fields[index].writer(text, fields[index].value);
+                append_escaped(line, text.data(), text.size());
+                line.append('"');
+            }
+            line.append('}');
+        }
+
+        double rate = msg.sampling_rate();
+        if (rate < 1) {
+            line.append(",\"sampling_rate\":", 17);
+            format_value(line, rate);
+        }
+
+        line.append("}\n", 2);
+    }
+
+    // json_stdout_sink -------------------------
+    //
+    json_stdout_sink::json_stdout_sink(const std::string &name, const std::string &pname, log_level level) :
+            json_file_sink(name, pname, level, stdout) {
+        // intentional...
+    }
+
+    json_stdout_sink::json_stdout_sink() :
+            json_file_sink("default", "pname", log_level::info, stdout) {
+        // intentional...
+    }
+
+    json_stdout_sink::json_stdout_sink(const std::string &name, const std::string &pname, log_level level, const flush_policy &policy) :
+            json_file_sink(name, pname, level, stdout, policy) {
+        // intentional...
+    }
+
+} // namespace logger
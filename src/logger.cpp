@@ -16,6 +16,14 @@ namespace logger {
 
     logger::logger(const std::string &name, sink *sink) : _name (name) {
         _sink.reset(sink);
+
+        for (auto &policy : _sampling) {
+            policy.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    logger::~logger() {
+        report_suppressed();
     }
 
     std::string logger::ecid() {
@@ -41,6 +49,50 @@ namespace logger {
         return _sink->level();
     };
 
+    void logger::set_log_level(log_levels level, const sampling &policy) {
+        set_sampling(level, policy);
+        _sink->set_log_level(level);
+    }
+
+    void logger::set_rate_limit(const rate_limit &limit) {
+        _limiter.set_limit(limit);
+    }
+
+    unsigned long long logger::suppressed() const {
+        return _limiter.suppressed();
+    }
+
+    void logger::report_suppressed() {
+        _limiter.drain([this](log_level level, unsigned long long suppressed, uint64_t elapsed) {
+            write_summary(level, suppressed, elapsed);
+        });
+    }
+
+    void logger::set_sampling(log_level level, const sampling &policy) {
+        if (level >= 0 && level <= LOG_TRACE) {
+            _sampling[level].store(sampling_details::pack(policy), std::memory_order_relaxed);
+        }
+    }
+
+    sampling logger::sampling_of(log_level level) const {
+        return sampling_details::unpack(sampling_policy(level));
+    }
+
+    void logger::write_sampled(log_level level, double rate, const char *fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        {
+            printf_message msg(fmt, args);
+            _sink->emit(level, sampled_message(rate, msg));
+        }
+        va_end(args);
+    }
+
+    void logger::write_summary(log_level level, unsigned long long suppressed, uint64_t elapsed) {
+        // round the period up to the second
+        _sink->write(level, "suppressed %llu similar messages in last %llus", suppressed, (elapsed + 999999999ULL) / 1000000000ULL);
+    }
+
     /** @return logger name */
     const std::string &logger::name() const {
         return _name;
@@ -50,4 +102,11 @@ namespace logger {
         return _sink->program_name();
     };
 
+    sink_metrics logger::metrics() {
+        sink_metrics result = _sink->metrics();
+        result.name = _name;
+
+        return result;
+    }
+
 } // namespace logger
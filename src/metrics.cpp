@@ -0,0 +1,152 @@
+//
+//  metrics.cpp
+//
+
+#include "logger/metrics.hpp"
+#include <mutex>
+#include <pthread.h> // pthread_atfork
+
+namespace logger {
+
+    // slots owned by live threads. Intentionally leaked: threads can exit (and release their slot) after static
+    // objects were destroyed.
+    struct metrics_slots {
+        std::mutex mutex;
+        bool       used[METRICS_SLOTS];
+    };
+
+    static metrics_slots &slots() {
+        static metrics_slots *slots = new metrics_slots{};
+        return *slots;
+    }
+
+    // gives the thread's slot back when the thread exits
+    struct slot_owner {
+        ~slot_owner() {
+            unsigned slot = metrics_details::current_slot();
+
+            // counts made after this (i.e. by other thread_local destructors) go to the shared shard
+            metrics_details::current_slot() = METRICS_SLOTS + 1;
+
+            if (slot != 0 && slot - 1 < METRICS_SLOTS) {
+                std::lock_guard<std::mutex> lock(slots().mutex);
+                slots().used[slot - 1] = false;
+            }
+        }
+    };
+
+    // in the child, only the forking thread is left: it keeps its slot, the others are free
+    static void after_fork() {
+        unsigned slot = metrics_details::current_slot();
+
+        for (size_t index = 0; index < METRICS_SLOTS; index++) {
+            slots().used[index] = slot != 0 && slot - 1 == index;
+        }
+        slots().mutex.unlock();
+    }
+
+    unsigned metrics_details::acquire_slot() {
+        static std::once_flag fork_handlers;
+        std::call_once(fork_handlers, []() {
+            pthread_atfork(
+                    []() { slots().mutex.lock(); },
+                    []() { slots().mutex.unlock(); },
+                    &after_fork);
+        });
+
+        unsigned slot = METRICS_SLOTS;
+        {
+            std::lock_guard<std::mutex> lock(slots().mutex);
+            for (unsigned index = 0; index < METRICS_SLOTS; index++) {
+                if (!slots().used[index]) {
+                    slots().used[index] = true;
+                    slot = index;
+                    break;
+                }
+            }
+        }
+
+        current_slot() = slot + 1;
+        static thread_local slot_owner owner;
+        (void) owner;
+
+        return slot;
+    }
+
+    // sink_metrics -------------------------
+    //
+    sink_metrics::sink_metrics() :
+            accepted(0),
+            filtered(0),
+            dropped(0),
+            bytes(0),
+            errors(0),
+            flushes(0),
+            latency{0} {
+        // intentional...
+    }
+
+    sink_metrics &sink_metrics::operator+=(const sink_metrics &other) {
+        accepted += other.accepted;
+        filtered += other.filtered;
+        dropped += other.dropped;
+        bytes += other.bytes;
+        errors += other.errors;
+        flushes += other.flushes;
+
+        for (size_t index = 0; index < LATENCY_BUCKETS; index++) {
+            latency[index] += other.latency[index];
+        }
+
+        return *this;
+    }
+
+    unsigned long long sink_metrics::latency_percentile(double rank) const {
+        unsigned long long total = 0;
+        for (auto count : latency) {
+            total += count;
+        }
+        if (total == 0) {
+            return 0;
+        }
+
+        auto target = static_cast<unsigned long long>(rank * static_cast<double>(total));
+        unsigned long long seen = 0;
+
+        for (size_t index = 0; index < LATENCY_BUCKETS; index++) {
+            seen += latency[index];
+            if (seen > target) {
+                return index == 0 ? 0 : (1ULL << index) - 1;
+            }
+        }
+
+        return (1ULL << (LATENCY_BUCKETS - 1)) - 1;
+    }
+
+    // metric_shards -------------------------
+    //
+    constexpr size_t metric_shards::COUNTERS;
+
+    metric_shards::metric_shards() {
+        for (auto &current : _shards) {
+            for (auto &value : current.values) {
+                value.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void metric_shards::collect(sink_metrics &out) const {
+        for (const auto &current : _shards) {
+            out.accepted += current.values[ACCEPTED].load(std::memory_order_relaxed);
+            out.filtered += current.values[FILTERED].load(std::memory_order_relaxed);
+            out.bytes += current.values[BYTES].load(std::memory_order_relaxed);
+            out.errors += current.values[ERRORS].load(std::memory_order_relaxed);
+            out.flushes += current.values[FLUSHES].load(std::memory_order_relaxed);
+
+            for (size_t index = 0; index < LATENCY_BUCKETS; index++) {
+                out.latency[index] += current.values[LATENCY + index].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+} // namespace logger
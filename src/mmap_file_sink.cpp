@@ -0,0 +1,241 @@
+//
+//  mmap_file_sink.cpp
+//
+
+#include "logger/mmap_file_sink.hpp"
+#include <fcntl.h>    // open, posix_fallocate
+#include <sys/mman.h> // mmap, munmap, msync
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // pread, pwrite, ftruncate, close
+#include <cerrno>
+#include <cstring>  // memcpy
+#include <chrono>
+
+namespace logger {
+
+    constexpr size_t mmap_file_sink::UNMAPPED;
+
+    // size of the file once its trailing \0 are removed (they're left by windows that weren't filled before a crash)
+    static size_t data_size(int fd) {
+        struct stat status{};
+        if (fstat(fd, &status) != 0 || status.st_size <= 0) {
+            return 0;
+        }
+
+        char chunk[4096];
+        auto end = static_cast<size_t>(status.st_size);
+
+        while (end > 0) {
+            size_t begin = end > sizeof(chunk) ? end - sizeof(chunk) : 0;
+            ssize_t count = pread(fd, chunk, end - begin, static_cast<off_t>(begin));
+            if (count <= 0) {
+                break;
+            }
+
+            for (auto pos = static_cast<size_t>(count); pos > 0; pos--) {
+                if (chunk[pos - 1] != 0) {
+                    return begin + pos;
+                }
+            }
+            end = begin;
+        }
+
+        return end;
+    }
+
+    mmap_file_sink::mmap_file_sink(const std::string &path) :
+            mmap_file_sink("mmap-file-sink", "app", log_level::info, path) {
+    }
+
+    mmap_file_sink::mmap_file_sink(const std::string &name, const std::string &pname, log_level level, const std::string &path, size_t window_size) :
+            file_sink(name, pname, level, nullptr),
+            _path(path),
+            _fd(-1),
+            _window_size(window_size),
+            _offset(0),
+            _fallbacks(0),
+            _running(true) {
+
+        auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (_window_size < page_size) {
+            _window_size = page_size;
+        }
+        _window_size = (_window_size + page_size - 1) / page_size * page_size;
+
+        for (auto &target : _windows) {
+            target.index.store(UNMAPPED);
+            target.address.store(nullptr);
+            target.users.store(0);
+        }
+
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (_fd < 0) {
+            throw sink_exception("mmap_file_sink failed to open " + path);
+        }
+
+        // append after the existing lines
+        size_t size = data_size(_fd);
+        if (ftruncate(_fd, static_cast<off_t>(size)) != 0) {
+            ::close(_fd);
+            throw sink_exception("mmap_file_sink failed to truncate " + path);
+        }
+        _offset.store(size);
+
+        maintain(); // the first windows are ready before the first line is written
+        _worker = std::thread(&mmap_file_sink::run, this);
+    }
+
+    mmap_file_sink::~mmap_file_sink() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = false;
+        }
+        _condition.notify_one();
+
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+
+        for (auto &target : _windows) {
+            unmap(target);
+        }
+
+        // the file grows one window at a time, give back what wasn't used
+        if (ftruncate(_fd, static_cast<off_t>(_offset.load())) != 0) {
+            // nothing we can do about it, the trailing \0 will be trimmed the next time the file is opened
+        }
+        ::close(_fd);
+    }
+
+    void mmap_file_sink::sync() {
+        std::lock_guard<std::mutex> lock(_mutex); // the background thread doesn't unmap anything meanwhile
+
+        for (auto &target : _windows) {
+            char *address = target.address.load();
+            if (target.index.load() != UNMAPPED && address != nullptr) {
+                msync(address, _window_size, MS_SYNC);
+            }
+        }
+        fdatasync(_fd);
+    }
+
+    void mmap_file_sink::output(log_level, const char *data, size_t size) {
+        size_t offset = _offset.fetch_add(size, std::memory_order_relaxed);
+        bool wake_up = false;
+        count_bytes(size);
+
+        // a line may span two windows
+        while (size > 0) {
+            size_t index = offset / _window_size;
+            size_t begin = offset % _window_size;
+            size_t chunk = size < _window_size - begin ? size : _window_size - begin;
+
+            if (!copy(index, begin, data, chunk)) {
+                // the window isn't mapped (yet), don't wait for it
+                _fallbacks.fetch_add(1, std::memory_order_relaxed);
+                wake_up = true;
+
+                size_t remaining = chunk;
+                const char *source = data;
+                off_t position = static_cast<off_t>(offset);
+
+                while (remaining > 0) {
+                    ssize_t written = pwrite(_fd, source, remaining, position);
+                    if (written < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        count_errors(1);
+                        break;
+                    }
+                    source += written;
+                    position += written;
+                    remaining -= static_cast<size_t>(written);
+                }
+            }
+
+            // entering a new window, the background thread can map the one after
+            wake_up = wake_up || begin == 0 || chunk < size;
+
+            offset += chunk;
+            data += chunk;
+            size -= chunk;
+        }
+
+        if (wake_up) {
+            _condition.notify_one();
+        }
+    }
+
+    bool mmap_file_sink::copy(size_t index, size_t offset, const char *data, size_t size) {
+        window &target = _windows[index % MMAP_SINK_WINDOWS];
+
+        // users must be incremented before index is checked, see unmap()
+        target.users.fetch_add(1);
+        bool mapped = target.index.load() == index;
+
+        if (mapped) {
+            memcpy(target.address.load(std::memory_order_relaxed) + offset, data, size);
+        }
+
+        target.users.fetch_sub(1, std::memory_order_release);
+
+        return mapped;
+    }
+
+    void mmap_file_sink::map(window &target, size_t index) {
+        auto offset = static_cast<off_t>(index * _window_size);
+
+        // the file must cover the window before it's mapped (this never shrinks the file)
+        if (posix_fallocate(_fd, offset, static_cast<off_t>(_window_size)) != 0) {
+            return;
+        }
+
+        void *address = mmap(nullptr, _window_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, offset);
+        if (address == MAP_FAILED) {
+            return;
+        }
+
+        target.address.store(static_cast<char *>(address));
+        target.index.store(index); // published: writers may use it from now on
+    }
+
+    void mmap_file_sink::unmap(window &target) {
+        if (target.index.load() == UNMAPPED) {
+            return;
+        }
+
+        // writers that see UNMAPPED won't touch the window, wait for the ones that are copying.
+        target.index.store(UNMAPPED);
+        while (target.users.load() > 0) {
+            std::this_thread::yield();
+        }
+
+        munmap(target.address.load(), _window_size);
+        target.address.store(nullptr);
+    }
+
+    void mmap_file_sink::maintain() {
+        size_t current = _offset.load(std::memory_order_relaxed) / _window_size;
+
+        // keep the previous window (slow writers may still use it), the current one and the next ones
+        for (size_t index = current; index < current + MMAP_SINK_WINDOWS - 1; index++) {
+            window &target = _windows[index % MMAP_SINK_WINDOWS];
+
+            if (target.index.load() != index) {
+                unmap(target);
+                map(target, index);
+            }
+        }
+    }
+
+    void mmap_file_sink::run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (_running) {
+            maintain();
+            _condition.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+
+} // namespace logger
@@ -0,0 +1,64 @@
+//
+//  rate_limiter.cpp
+//
+
+#include "logger/rate_limiter.hpp"
+
+namespace logger {
+
+    rate_limiter::rate_limiter() :
+            _sites(nullptr),
+            _interval(0),
+            _burst_interval(0) {
+        // intentional...
+    }
+
+    rate_limiter::~rate_limiter() {
+        delete[] _sites.load();
+    }
+
+    void rate_limiter::set_limit(const rate_limit &limit) {
+
+        // the table is allocated once, the first time a limit is set, and kept until the limiter is destroyed
+        if (limit.burst > 0 && _sites.load() == nullptr) {
+            slot *sites = new slot[RATE_LIMITER_SITES];
+            for (size_t index = 0; index < RATE_LIMITER_SITES; index++) {
+                sites[index].key.store(0, std::memory_order_relaxed);
+                sites[index].arrival.store(0, std::memory_order_relaxed);
+                sites[index].suppressed.store(0, std::memory_order_relaxed);
+                sites[index].reported.store(0, std::memory_order_relaxed);
+                sites[index].since.store(0, std::memory_order_relaxed);
+            }
+
+            slot *expected = nullptr;
+            if (!_sites.compare_exchange_strong(expected, sites)) {
+                delete[] sites; // another thread set a limit in the meantime
+            }
+        }
+
+        double per_second = limit.per_second > 0 ? limit.per_second : 1;
+        auto interval = static_cast<uint64_t>(1e9 / per_second);
+        if (interval == 0) {
+            interval = 1;
+        }
+
+        _interval.store(interval, std::memory_order_relaxed);
+        _burst_interval.store(interval * limit.burst, std::memory_order_relaxed);
+    }
+
+    unsigned long long rate_limiter::suppressed() const {
+        slot *sites = _sites.load(std::memory_order_acquire);
+        if (sites == nullptr) {
+            return 0;
+        }
+
+        // suppressed messages are only counted by their call site, so that a storm doesn't contend on a shared counter
+        unsigned long long total = 0;
+        for (size_t index = 0; index < RATE_LIMITER_SITES; index++) {
+            total += sites[index].reported.load(std::memory_order_relaxed) + sites[index].suppressed.load(std::memory_order_relaxed);
+        }
+
+        return total;
+    }
+
+} // namespace logger
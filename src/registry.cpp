@@ -13,6 +13,15 @@ namespace logger {
      */
     std::unique_ptr<registry>  registry::_registry{new registry()};
 
+    // loggers each thread already found. Weak pointers are used, so that removed loggers are not kept alive by threads
+    // that don't log anymore.
+    struct known_loggers {
+        uint64_t generation;
+        std::unordered_map<std::string, std::weak_ptr<class logger>> loggers;
+    };
+
+    static thread_local known_loggers thread_loggers{0, {}};
+
     logger_ptr get(const std::string &name) {
 
         return registry::instance().get(name);
@@ -30,6 +39,19 @@ namespace logger {
         registry::instance().set_program_name(pname);
     }
 
+    void set_level(const log_level level, const sampling &policy) {
+        registry::instance().set_sampling(level, policy);
+        registry::instance().set_log_level(level);
+    }
+
+    void set_sampling(const log_level level, const sampling &policy) {
+        registry::instance().set_sampling(level, policy);
+    }
+
+    std::vector<sink_metrics> metrics() {
+        return registry::instance().metrics();
+    }
+
     void reset_registry() {
         registry::instance().reset();
     }
@@ -62,6 +84,20 @@ namespace logger {
 #endif
     }
 
+    void registry::set_sampling(const log_level level, const sampling &policy) {
+        if (level < 0 || level > LOG_TRACE) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lck(_mutex);
+
+        for (auto & _logger : _loggers) {
+            _logger.second->set_sampling(level, policy);
+        }
+
+        _sampling[level] = policy;
+    }
+
     void registry::set_ecid(const std::string &ecid) {
         std::lock_guard<std::mutex> lck(_mutex);
 
@@ -74,6 +110,19 @@ namespace logger {
 #endif
     }
 
+    std::vector<sink_metrics> registry::metrics() {
+        std::lock_guard<std::mutex> lck(_mutex);
+
+        std::vector<sink_metrics> result;
+        result.reserve(_loggers.size());
+
+        for (auto &current : _loggers) {
+            result.push_back(current.second->metrics());
+        }
+
+        return result;
+    }
+
     void registry::add(const logger_ptr &logger) {
         // we don(t need to protect the map access beacause it's done by the only method that accesses
         // this one.
@@ -90,14 +139,45 @@ namespace logger {
         std::lock_guard<std::mutex> lck(_mutex);
 
         _loggers.erase(name);
+        _generation.fetch_add(1, std::memory_order_release);
     }
 
     void registry::reset() {
         std::lock_guard<std::mutex> lck(_mutex);
         _loggers.clear();
+        _generation.fetch_add(1, std::memory_order_release);
+    }
+
+    logger_ptr registry::find(const std::string &name) {
+        uint64_t generation = _generation.load(std::memory_order_acquire);
+
+        if (thread_loggers.generation != generation) {
+            // some loggers were removed since this thread last looked, forget everything.
+            thread_loggers.loggers.clear();
+            thread_loggers.generation = generation;
+            return logger_ptr();
+        }
+
+        auto search = thread_loggers.loggers.find(name);
+        if (search == thread_loggers.loggers.end()) {
+            return logger_ptr();
+        }
+
+        return search->second.lock();
+    }
+
+    void registry::remember(const logger_ptr &logger) {
+        uint64_t generation = _generation.load(std::memory_order_relaxed); // stable, the caller holds _mutex
+
+        if (thread_loggers.generation != generation) {
+            thread_loggers.loggers.clear();
+            thread_loggers.generation = generation;
+        }
+
+        thread_loggers.loggers[logger->name()] = logger;
     }
 
-    registry::registry() noexcept : _level(log_levels::info), _pname("program") {
+    registry::registry() noexcept : _generation(0), _level(log_levels::info), _pname("program") {
         // intentional...
 #       ifdef DEBUG
         std::cout << "DEBUG Create regsistry instance..." << std::endl;
@@ -0,0 +1,226 @@
+//
+//  rotating_file_sink.cpp
+//
+
+#include "logger/rotating_file_sink.hpp"
+#include <fcntl.h>    // open, fallocate
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // write, close, unlink
+#include <cstdio>     // rename
+#include <cerrno>
+#include <chrono>
+
+namespace logger {
+
+    rotating_file_sink::rotating_file_sink(const std::string &path, const rotation_policy &policy) :
+            rotating_file_sink("rotating-file-sink", "app", log_level::info, path, policy) {
+    }
+
+    rotating_file_sink::rotating_file_sink(const std::string &name, const std::string &pname, log_level level, const std::string &path, const rotation_policy &policy) :
+            file_sink(name, pname, level, nullptr),
+            _path(path),
+            _next_path(path + ".next"),
+            _policy(policy),
+            _current(nullptr),
+            _next(nullptr),
+            _deadline(0),
+            _requested(false),
+            _rotations(0),
+            _phase(0),
+            _guards{},
+            _running(true) {
+
+        segment *current = open_segment(_path, false);
+        if (current == nullptr) {
+            throw sink_exception("rotating_file_sink failed to open " + _path);
+        }
+        _current.store(current);
+
+        if (_policy.interval > 0) {
+            _deadline = time(nullptr) + _policy.interval;
+        }
+
+        _worker = std::thread(&rotating_file_sink::run, this);
+    }
+
+    rotating_file_sink::~rotating_file_sink() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _running = false;
+        }
+        _condition.notify_one();
+
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+
+        close_segment(_current.exchange(nullptr));
+
+        if (_next != nullptr) {
+            close_segment(_next);
+            unlink(_next_path.c_str());
+        }
+    }
+
+    void rotating_file_sink::rotate() {
+        _requested.store(true);
+        _condition.notify_one();
+    }
+
+    void rotating_file_sink::output(log_level, const char *data, size_t size) {
+        // pick the active segment and tell the background thread we're using it. The guard covers the gap between
+        // loading the pointer and counting ourselves as a user: close_segment() waits for the guards of the phase that
+        // saw the previous segment to drop to zero. If the phase changed before we were counted, a rotation may already
+        // have waited on it, so we count ourselves again in the new phase.
+        unsigned phase = _phase.load();
+        for (;;) {
+            _guards[phase].fetch_add(1);
+            unsigned now = _phase.load();
+            if (now == phase) {
+                break;
+            }
+            _guards[phase].fetch_sub(1);
+            phase = now;
+        }
+        segment *current = _current.load();
+        current->users.fetch_add(1);
+        _guards[phase].fetch_sub(1);
+
+        // one call per line, so that lines of concurrent writers are not mixed up (the file is opened with O_APPEND)
+        size_t total = 0;
+        while (size > 0) {
+            ssize_t written = ::write(current->fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                count_errors(1);
+                break;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            total += static_cast<size_t>(written);
+            current->written.fetch_add(static_cast<size_t>(written), std::memory_order_relaxed);
+        }
+        count_bytes(total);
+
+        bool full = _policy.max_size > 0 && current->written.load(std::memory_order_relaxed) >= _policy.max_size;
+
+        current->users.fetch_sub(1, std::memory_order_release);
+
+        if (full && !_requested.exchange(true)) {
+            _condition.notify_one();
+        }
+    }
+
+    rotating_file_sink::segment *rotating_file_sink::open_segment(const std::string &path, bool truncate) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+        if (fd < 0) {
+            return nullptr;
+        }
+
+        struct stat status{};
+        fstat(fd, &status);
+
+#ifdef FALLOC_FL_KEEP_SIZE
+        // reserve the blocks now, the file size doesn't change so O_APPEND still writes at the end of the data.
+        if (_policy.max_size > 0) {
+            fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(_policy.max_size));
+        }
+#endif
+
+        auto *result = new segment;
+        result->fd = fd;
+        result->written.store(static_cast<size_t>(status.st_size));
+        result->users.store(0);
+
+        return result;
+    }
+
+    void rotating_file_sink::close_segment(segment *target) {
+        if (target == nullptr) {
+            return;
+        }
+
+        // new writers count themselves in the other phase, so this one drains even under a steady load. Once it is
+        // empty, writers that may have loaded the target pointer are counted in target->users.
+        unsigned phase = _phase.load();
+        _phase.store(phase ^ 1);
+        while (_guards[phase].load() > 0) {
+            std::this_thread::yield();
+        }
+
+        // wait for the writers that still use it
+        while (target->users.load() > 0) {
+            std::this_thread::yield();
+        }
+
+#ifdef FALLOC_FL_KEEP_SIZE
+        // give back the blocks that were reserved but not used
+        if (_policy.max_size > 0) {
+            ftruncate(target->fd, static_cast<off_t>(target->written.load()));
+        }
+#endif
+
+        ::close(target->fd);
+        delete target;
+    }
+
+    void rotating_file_sink::rotate_now() {
+        if (_next == nullptr) {
+            _next = open_segment(_next_path, true);
+            if (_next == nullptr) {
+                return; // try again later, writers keep using the current segment
+            }
+        }
+
+        segment *previous = _current.exchange(_next, std::memory_order_acq_rel);
+        _next = nullptr;
+        _requested.store(false);
+        _rotations.fetch_add(1, std::memory_order_relaxed);
+
+        // path.N is deleted, path.N-1 becomes path.N, ..., path becomes path.1
+        if (_policy.retention > 0) {
+            unlink((_path + "." + std::to_string(_policy.retention)).c_str());
+
+            for (unsigned int index = _policy.retention - 1; index > 0; index--) {
+                rename((_path + "." + std::to_string(index)).c_str(), (_path + "." + std::to_string(index + 1)).c_str());
+            }
+            rename(_path.c_str(), (_path + ".1").c_str());
+        } else {
+            unlink(_path.c_str());
+        }
+        rename(_next_path.c_str(), _path.c_str());
+
+        close_segment(previous);
+
+        if (_policy.interval > 0) {
+            _deadline = time(nullptr) + _policy.interval;
+        }
+    }
+
+    void rotating_file_sink::run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        while (_running) {
+            lock.unlock();
+
+            bool expired = _deadline > 0 && time(nullptr) >= _deadline;
+
+            if (_requested.load() || expired) {
+                rotate_now();
+            }
+
+            // prepare the next segment, so that the next rotation is only a pointer swap
+            if (_next == nullptr) {
+                _next = open_segment(_next_path, true);
+            }
+
+            lock.lock();
+            if (_running && !_requested.load()) {
+                _condition.wait_for(lock, std::chrono::milliseconds(100));
+            }
+        }
+    }
+
+} // namespace logger
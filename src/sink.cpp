@@ -7,16 +7,47 @@
 //
 
 #include "logger/sinks.hpp"
+#include <cstring> // std::memcpy
 
 namespace logger {
 
+    // innermost ECID guard of each thread
+    static thread_local const ecid_guard *current_ecid_guard = nullptr;
+
+    // render an ECID the way sinks print it ([M ECID="..."]), an empty ECID is rendered as "- ".
+    static size_t render_ecid(const char *ecid, size_t size, char *target) {
+        static const char prefix[] = "[M ECID=\"";
+
+        if (size == 0) {
+            memcpy(target, "- ", 3);
+            return 2;
+        }
+
+        if (size > static_cast<size_t>(MAXECIDLEN)) {
+            size = MAXECIDLEN;
+        }
+
+        memcpy(target, prefix, sizeof(prefix) - 1);
+        memcpy(target + sizeof(prefix) - 1, ecid, size);
+        memcpy(target + sizeof(prefix) - 1 + size, "\"]", 3);
+
+        return sizeof(prefix) - 1 + size + 2;
+    }
+
+    constexpr size_t sink::ECID_WORDS;
+
     // abstract sink class -------------------
     //
     sink::sink(const std::string &name, const std::string &pname, log_level level) :
+            _ecid_sequence(0),
+            _ecid_size(0),
             _name(name),
             _pname(pname),
             _level(level){
-        // intentional...
+
+        for (auto &word : _ecid_words) {
+            word.store(0, std::memory_order_relaxed);
+        }
 #ifdef DEBUG
         printf("DEBUG %s (%s,%d).\n", __FUNCTION__, __FILE__, __LINE__);
 #endif
@@ -31,36 +62,89 @@ namespace logger {
         // intentional
     }
 
+    sink_metrics sink::metrics() {
+        sink_metrics result;
+        result.name = _name;
+        _metrics.collect(result);
+
+        return result;
+    }
+
     void sink::set_log_level(log_levels level) {
         _level = level;
     };
 
-    log_levels sink::level() {
-        return _level;
-    };
-
     std::string sink::ecid() {
-#if __cplusplus >= 201703L
-        std::shared_lock lock(_shared_mutex);
-#else
-        std::lock_guard<std::mutex> lock(_mutex);
-#endif
+        char target[ECID_SIZE];
 
-        return _ecid;
+        return std::string(target, ecid(target, ECID_SIZE));
     }
 
-    void sink::set_ecid(const std::string &ecid) {
-#if __cplusplus >= 201703L
-        std::unique_lock lock(_shared_mutex);
-#else
-        std::lock_guard<std::mutex> lock(_mutex);
-#endif
+    void sink::emit(log_level level, const message &msg) {
+        if (level <= this->level()) {
+            static thread_local buffer rendered;
+            rendered.clear();
+
+            msg.render(rendered);
+            write(level, "%s", rendered.data());
+        }
+    }
+
+    size_t sink::ecid(char *target, size_t size) {
+        const ecid_guard *guard = current_ecid_guard;
+        size_t length;
+
+        if (guard != nullptr) {
+            length = guard->rendered_size() < size - 1 ? guard->rendered_size() : size - 1;
+            memcpy(target, guard->rendered(), length);
 
-        if (!ecid.empty()) {
-            _ecid = "[M ECID=\"" + ecid.substr(0, MAXECIDLEN) + "\"]";
         } else {
-            _ecid = "- ";
+            uint64_t words[ECID_WORDS];
+            unsigned sequence;
+
+            // copy until no writer changed the ECID in between
+            do {
+                sequence = _ecid_sequence.load(std::memory_order_acquire);
+                while ((sequence & 1) != 0) {
+                    std::this_thread::yield();
+                    sequence = _ecid_sequence.load(std::memory_order_acquire);
+                }
+
+                length = static_cast<size_t>(_ecid_size.load(std::memory_order_relaxed));
+                for (size_t index = 0; index < ECID_WORDS; index++) {
+                    words[index] = _ecid_words[index].load(std::memory_order_relaxed);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while (sequence != _ecid_sequence.load(std::memory_order_relaxed));
+
+            if (length > size - 1) {
+                length = size - 1;
+            }
+            memcpy(target, words, length);
         }
+
+        target[length] = 0;
+
+        return length;
+    }
+
+    void sink::set_ecid(const std::string &ecid) {
+        uint64_t words[ECID_WORDS] = {0};
+        size_t length = render_ecid(ecid.data(), ecid.size(), reinterpret_cast<char *>(words));
+
+        std::lock_guard<std::mutex> lock(_ecid_mutex);
+
+        unsigned sequence = _ecid_sequence.load(std::memory_order_relaxed);
+        _ecid_sequence.store(sequence + 1, std::memory_order_relaxed); // odd: readers wait
+        std::atomic_thread_fence(std::memory_order_release);
+
+        _ecid_size.store(length, std::memory_order_relaxed);
+        for (size_t index = 0; index < ECID_WORDS; index++) {
+            _ecid_words[index].store(words[index], std::memory_order_relaxed);
+        }
+
+        _ecid_sequence.store(sequence + 2, std::memory_order_release);
     }
 
     std::string sink::log_level_name(log_level level) {
@@ -97,4 +181,38 @@ namespace logger {
         _name = name;
     }
 
+    // ecid_guard ----------------
+    //
+    ecid_guard::ecid_guard(const std::string &ecid) {
+        install(ecid.data(), ecid.size());
+    }
+
+    ecid_guard::ecid_guard(const char *ecid) {
+        install(ecid, ecid == nullptr ? 0 : strlen(ecid));
+    }
+
+    ecid_guard::~ecid_guard() {
+        current_ecid_guard = _previous;
+    }
+
+    const ecid_guard *ecid_guard::current() {
+        return current_ecid_guard;
+    }
+
+    void ecid_guard::install(const char *ecid, size_t size) {
+        if (size > static_cast<size_t>(MAXECIDLEN)) {
+            size = MAXECIDLEN;
+        }
+        if (size > 0) {
+            memcpy(_value, ecid, size);
+        }
+        _value[size] = 0;
+
+        _rendered_size = render_ecid(_value, size, _rendered);
+        _rendered[_rendered_size] = 0;
+
+        _previous = current_ecid_guard;
+        current_ecid_guard = this;
+    }
+
 } // namespace logger
@@ -0,0 +1,144 @@
+//
+//  staging.cpp
+//
+
+#include "logger/staging.hpp"
+#include "logger/thread_info.hpp"
+
+namespace logger {
+
+    // each thread keeps the rings it uses, so that finding one doesn't take any lock. When the thread exits, its rings
+    // are closed, the consumers drop them once they're empty.
+    struct thread_rings {
+        std::vector<std::pair<uint64_t, std::shared_ptr<staging_ring>>> entries;
+
+        ~thread_rings() {
+            for (auto &entry : entries) {
+                entry.second->close();
+            }
+        }
+    };
+
+    static thread_local thread_rings current_rings;
+    static std::atomic<uint64_t> staging_area_ids{0};
+
+    // staging_ring ----------------
+    //
+    constexpr uint32_t staging_ring::PADDING;
+    constexpr size_t   staging_ring::HEADER_SIZE;
+
+    staging_ring::staging_ring(size_t capacity) :
+            _capacity(64),
+            _head(0),
+            _tail(0),
+            _closed(false),
+            _retired(false),
+            _dropped(0),
+            _thread_id(static_cast<uint64_t>(current_thread().id)) {
+
+        while (_capacity < capacity) {
+            _capacity <<= 1;
+        }
+        _data.reset(new char[_capacity]);
+    }
+
+    bool staging_ring::push(const char *data, size_t size) {
+        if (!push(data, size, nullptr, 0)) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool staging_ring::push(const char *header, size_t header_size, const char *data, size_t size) {
+        if (_retired.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        size_t total = header_size + size;
+        size_t needed = aligned(total);
+        size_t head = _head.load(std::memory_order_relaxed);
+        size_t used = head - _tail.load(std::memory_order_acquire);
+        size_t offset = head & (_capacity - 1);
+        size_t contiguous = _capacity - offset;
+
+        // records are never split, if the end of the ring is too small it is skipped.
+        size_t skipped = contiguous < needed ? contiguous : 0;
+
+        if (total >= PADDING || used + skipped + needed > _capacity) {
+            return false;
+        }
+
+        if (skipped > 0) {
+            memcpy(_data.get() + offset, &PADDING, sizeof(PADDING));
+            head += skipped;
+            offset = 0;
+        }
+
+        auto record_size = static_cast<uint32_t>(total);
+        memcpy(_data.get() + offset, &record_size, sizeof(record_size));
+        memcpy(_data.get() + offset + HEADER_SIZE, header, header_size);
+        if (size > 0) {
+            memcpy(_data.get() + offset + HEADER_SIZE + header_size, data, size);
+        }
+
+        _head.store(head + needed, std::memory_order_release);
+
+        return true;
+    }
+
+    // staging_area ----------------
+    //
+    staging_area::staging_area(size_t ring_size) :
+            _id(++staging_area_ids),
+            _ring_size(ring_size),
+            _dropped(0) {
+        // intentional...
+    }
+
+    staging_area::~staging_area() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        // threads may still reference the rings, they are freed once the threads forget them.
+        for (auto &ring : _rings) {
+            ring->retire();
+        }
+    }
+
+    staging_ring &staging_area::ring() {
+        auto &entries = current_rings.entries;
+
+        for (auto &entry : entries) {
+            if (entry.first == _id) {
+                return *entry.second;
+            }
+        }
+
+        // forget the rings of staging areas that are gone
+        for (auto entry = entries.begin(); entry != entries.end();) {
+            entry = entry->second->retired() ? entries.erase(entry) : entry + 1;
+        }
+
+        auto ring = std::make_shared<staging_ring>(_ring_size);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _rings.push_back(ring);
+        }
+        entries.emplace_back(_id, ring);
+
+        return *ring;
+    }
+
+    unsigned long long staging_area::dropped() {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        unsigned long long count = _dropped;
+        for (auto &ring : _rings) {
+            count += ring->dropped();
+        }
+
+        return count;
+    }
+
+} // namespace logger
@@ -18,4 +18,9 @@ namespace logger {
         file_sink("default", "pname", log_level::info, stderr){
     }
 
+    stderr_sink::stderr_sink(const std::string &name, const std::string &pname, log_level level, const flush_policy &policy) :
+            file_sink(name, pname, level, stderr, policy) {
+        // intentional...
+    }
+
 } // namespace logger
@@ -16,4 +16,9 @@ namespace logger {
         // intentional...
     };
 
+    stdout_sink::stdout_sink(const std::string &name, const std::string &pname, log_level level, const flush_policy &policy) :
+            file_sink(name, pname, level, stdout, policy) {
+        // intentional...
+    }
+
 } // namespace logger
@@ -4,25 +4,114 @@
 //
 
 #include "logger/sinks.hpp"
+#include "logger/probes.hpp"
 #include <syslog.h>
+#include <sys/socket.h> // socket, connect, sendmmsg
+#include <sys/time.h>   // gettimeofday
+#include <sys/un.h>     // sockaddr_un
+#include <cerrno>
+#include <chrono>
 #include <cstring> // std::memset
+#include <algorithm> // std::find
+#include <pthread.h> // pthread_atfork
+#include <new>       // placement new
+#include <ctime>
 
 namespace logger {
 
+    // syslog sinks alive in this process, their process ID must be rendered again in a forked child. Intentionally
+    // leaked: sinks held by static loggers can be destroyed after this would be.
+    struct live_syslog_sinks {
+        std::mutex                 mutex;
+        std::vector<syslog_sink *> sinks;
+    };
+
+    static live_syslog_sinks &live_sinks() {
+        static live_syslog_sinks *sinks = new live_syslog_sinks;
+        return *sinks;
+    }
+
+    // render the RFC5424 timestamp (UTC), the date and time part is only rendered once per second and per thread
+    static size_t render_timestamp(char *target, size_t size) {
+        struct cache {
+            time_t seconds;
+            size_t length;
+            char   prefix[DATE_TIME_SIZE];
+        };
+        static thread_local cache current{-1, 0, {0}};
+
+        timeval current_time{0};
+        gettimeofday(&current_time, nullptr);
+
+        if (current_time.tv_sec != current.seconds) {
+            struct std::tm utc_time{0};
+            gmtime_r(&current_time.tv_sec, &utc_time);
+
+            int length = snprintf(current.prefix, DATE_TIME_SIZE, "%d-%02d-%02dT%02d:%02d:%02d.",
+                                  utc_time.tm_year + 1900,
+                                  utc_time.tm_mon + 1,
+                                  utc_time.tm_mday,
+                                  utc_time.tm_hour,
+                                  utc_time.tm_min,
+                                  utc_time.tm_sec);
+
+            current.length = length > 0 ? static_cast<size_t>(length) : 0;
+            current.seconds = current_time.tv_sec;
+        }
+
+        size_t length = current.length + 7; // prefix + microseconds + Z
+        if (length >= size) {
+            target[0] = 0;
+            return 0;
+        }
+
+        memcpy(target, current.prefix, current.length);
+
+        auto micros = static_cast<long>(current_time.tv_usec);
+        for (char *digit = target + current.length + 5; digit >= target + current.length; digit--) {
+            *digit = static_cast<char>('0' + (micros % 10));
+            micros /= 10;
+        }
+
+        target[length - 1] = 'Z';
+        target[length] = 0;
+
+        return length;
+    }
+
     syslog_sink::syslog_sink(const syslog::facility &facility, int options) :
             syslog_sink("default", "pname", log_level::info, facility, options){
 
     }
 
+    syslog_sink::syslog_sink(const syslog::facility &facility, int options, const std::string &path, unsigned int batch, unsigned int interval) :
+            syslog_sink("default", "pname", log_level::info, facility, options, path, batch, interval){
+
+    }
+
     syslog_sink::syslog_sink() :
             syslog_sink("default", "pname", log_level::info, syslog::user_facility, 0){
         // intentional...
     };
 
     syslog_sink::syslog_sink(const std::string &name, const std::string &pname, log_level level, const syslog::facility &facility, int options):
-            sink(name, pname, level) {
+            syslog_sink(name, pname, level, facility, options, SYSLOG_PATH) {
+        // intentional...
+    }
+
+    syslog_sink::syslog_sink(const std::string &name, const std::string &pname, log_level level, const syslog::facility &facility, int options, const std::string &path, unsigned int batch, unsigned int interval):
+            sink(name, pname, level),
+            _path(path),
+            _facility(static_cast<int>(facility.code())),
+            _options(options == 0 ? LOG_PID : options),
+            _socket(-1),
+            _batch(batch > 0 ? batch : 1),
+            _interval(interval),
+            _connected(false),
+            _stopping(false),
+            _sent(0),
+            _dropped(0) {
 
-//        try {
 #ifdef DEBUG
             printf("DEBUG %s name: %s, pname: %s, level: %d, facility: %d, options: %d\n", __FUNCTION__,
                 name.c_str(),
@@ -34,24 +123,52 @@ namespace logger {
 #endif
             set_name(name);
 
-            if (options == 0) {
-                options = LOG_PID;
+            char hostname[HOST_NAME_MAX];
+            hostname[0] = 0;
+            gethostname(hostname, HOST_NAME_MAX);
+            _hostname = hostname[0] == 0 ? "-" : hostname;
+
+            _procid = (_options & LOG_PID) != 0 ? std::to_string(getpid()) : "-";
+
+            _socket = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            if (_socket < 0) {
+                throw sink_exception(std::string("syslog_sink failed to create its socket: ") + strerror(errno));
             }
 
-#ifdef DEBUG
-            printf("DEBUG %s calling openlog(%s, %d, %d)\n",
-                __FUNCTION__,
-                pname.c_str(),
-                options,
-                facility,
-                __FILE__,__LINE__);
-#endif
+            if ((_options & LOG_NDELAY) != 0) {
+                connect();
+            }
 
-            openlog(program_name().c_str(), options, (int)facility.code());
+            _ends.reserve(_batch);
 
- //       } catch ( std::exception &err ){
- //           throw logger_exception(err.what());
- //       }
+            if (_batch > 1 && _interval > 0) {
+                _timer = std::thread(&syslog_sink::run_timer, this);
+            }
+
+            // last, a sink which constructor throws is never registered
+            static std::once_flag fork_handlers;
+            std::call_once(fork_handlers, []() {
+                // the sinks' mutexes are locked too, the child must not inherit one held by a thread it doesn't have
+                pthread_atfork(
+                        []() {
+                            live_sinks().mutex.lock();
+                            for (auto current : live_sinks().sinks) {
+                                current->_batch_mutex.lock();
+                                current->_connect_mutex.lock();
+                            }
+                        },
+                        []() {
+                            for (auto current : live_sinks().sinks) {
+                                current->_connect_mutex.unlock();
+                                current->_batch_mutex.unlock();
+                            }
+                            live_sinks().mutex.unlock();
+                        },
+                        &syslog_sink::after_fork);
+            });
+
+            std::lock_guard<std::mutex> lock(live_sinks().mutex);
+            live_sinks().sinks.push_back(this);
     };
 
     syslog_sink::syslog_sink(const std::string &name, const std::string &pname, log_level level) :
@@ -59,60 +176,228 @@ namespace logger {
         // intentional
     }
 
+    syslog_sink::~syslog_sink() {
+        {
+            std::lock_guard<std::mutex> lock(live_sinks().mutex);
+            auto &sinks = live_sinks().sinks;
+            sinks.erase(std::find(sinks.begin(), sinks.end(), this));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_batch_mutex);
+            _stopping = true;
+        }
+        _timer_condition.notify_one();
+
+        if (_timer.joinable()) {
+            _timer.join();
+        }
+
+        flush();
+        ::close(_socket);
+    }
+
     void syslog_sink::write(log_level level, const char *fmt, ...) {
 #ifdef DEBUG
         printf("DEBUG %s _level/level: %d/%d, pattern: [%s] (%s,%d)\n", __FUNCTION__, _level, level, _pattern.c_str(), __FILE__,__LINE__);
 #endif
 
+        if (level <= this->level()) {
+            va_list args;
+            va_start(args, fmt);
+            {
+                printf_message msg(fmt, args);
+                emit(level, msg);
+            }
+            va_end(args);
+        }
+    }
+
+    void syslog_sink::emit(log_level level, const message &msg) {
         log_level target_level =  this->level(); // we use level's accessor because access needs to be threadsafe
 
         if (target_level >= level) {
 
-            // fill a buffer with the user message
-            va_list args1;
-            va_list args2;
+            auto syslog_level = level;
+
+            if ( level == log_level::trace ){
+                // The syslog_sink, considers that TRACE and DEBUG are the same.
+                syslog_level = log_level::debug ;
+            }
+
+            static thread_local buffer packet;
+            packet.clear();
 
-            va_start(args1, fmt); // initialize va_list
-            va_copy(args2, args1); // save a copy args1 -> args2
+            char now[DATE_TIME_SIZE];
+            render_timestamp(now, DATE_TIME_SIZE);
 
-            // this call only returns the actual number of bytes needed to store the message.
-            // It doesn't count the needed end-of-string
-            size_t buffer_size = vsnprintf(NULL, 0, fmt, args1) + 1; // plus 1 character to store \0
-            va_end(args1); // don't need this one anymore
+            char ecid[ECID_SIZE];
+            this->ecid(ecid, ECID_SIZE); // we use ecid's accessor because access needs to be threadsafe
 
-            // add one more character to handle \n (see code below)
-            char buffer[buffer_size + 1];
-            memset(buffer, 0, buffer_size + 1);
+            packet.printf(SYSLOG_PATTERN,
+                          _facility * 8 + syslog_level,
+                          now,
+                          _hostname.c_str(),
+                          program_name().c_str(),
+                          _procid.c_str(),
+                          ecid[0] == 0 ? "- " : ecid);
+            packet.append(_pattern.data(), _pattern.size());
 
-            // fill buffer with message ...
-            vsnprintf(buffer, buffer_size, fmt, args2);
-            size_t len = strlen(buffer);
-            va_end(args2);
+            msg.render(packet);
 
-            // add a new line if not already there
-            if (buffer[len - 1] != '\n') {
-                buffer[len] = '\n'; // override ending \0 (that's why we provisioned for one more character above)
+            // a datagram is a record, no end-of-line needed
+            size_t size = packet.size();
+            while (size > 0 && packet.data()[size - 1] == '\n') {
+                size--;
             }
 
-            auto syslog_level = level;
+            CPP_LOGGER_PROBE(formatted, level, name().c_str(), size);
 
-            if ( level == log_level::trace ){
-                // The syslog_sink, considers that TRACE and DEBUG are the same.
-                syslog_level = log_level::debug ;
+            if ((_options & LOG_PERROR) != 0) {
+                fprintf(stderr, "%.*s\n", static_cast<int>(size), packet.data());
+            }
+
+            if (_batch == 1) {
+                transmit(packet.data(), &size, 1);
+                CPP_LOGGER_PROBE(written, level, name().c_str(), size);
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(_batch_mutex);
+                _packets.append(packet.data(), size);
+                _ends.push_back(_packets.size());
+
+                if (_ends.size() >= _batch || level <= log_level::err) {
+                    transmit(_packets.data(), _ends.data(), _ends.size());
+                    _packets.clear();
+                    _ends.clear();
+                }
             }
+            CPP_LOGGER_PROBE(written, level, name().c_str(), size);
+        }
+    }
+
+    void syslog_sink::flush() {
+        std::lock_guard<std::mutex> lock(_batch_mutex);
+
+        if (!_ends.empty()) {
+            transmit(_packets.data(), _ends.data(), _ends.size());
+            _packets.clear();
+            _ends.clear();
+        }
+    }
+
+    void syslog_sink::after_fork() {
+        // only the forking thread runs in the child, the mutexes were locked by the prepare handler
+        for (auto current : live_sinks().sinks) {
+            if ((current->_options & LOG_PID) != 0) {
+                current->_procid = std::to_string(getpid());
+            }
+
+            // the timer thread wasn't forked: its handle and the condition it was waiting on are abandoned (neither
+            // can be joined nor destroyed) and a new timer is started in their place.
+            if (current->_timer.joinable()) {
+                new (&current->_timer_condition) std::condition_variable;
+                new (&current->_timer) std::thread(&syslog_sink::run_timer, current);
+            }
+            current->_connect_mutex.unlock();
+            current->_batch_mutex.unlock();
+        }
+        live_sinks().mutex.unlock();
+    }
+
+    void syslog_sink::run_timer() {
+        std::unique_lock<std::mutex> lock(_batch_mutex);
 
-            std::string ecid = this->ecid(); // we use ecid's accessor because access needs to be threadsafe
+        while (!_stopping) {
+            _timer_condition.wait_for(lock, std::chrono::milliseconds(_interval));
 
-            ::syslog ( syslog_level,
-                    _pattern.c_str(),
-                    ecid.empty() ? "" : ecid.c_str(),
-                    buffer);
+            if (!_stopping && !_ends.empty()) {
+                transmit(_packets.data(), _ends.data(), _ends.size());
+                _packets.clear();
+                _ends.clear();
+            }
+        }
+    }
+
+    bool syslog_sink::connect() {
+        std::lock_guard<std::mutex> lock(_connect_mutex);
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, _path.c_str(), sizeof(address.sun_path) - 1);
+
+        // connecting a datagram socket again only changes its peer, concurrent senders keep a valid descriptor
+        bool connected = ::connect(_socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+        _connected.store(connected);
+
+        return connected;
+    }
+
+    void syslog_sink::transmit(const char *data, const size_t *ends, size_t count) {
+        static thread_local std::vector<mmsghdr> messages;
+        static thread_local std::vector<iovec>   vectors;
+
+        messages.resize(count);
+        vectors.resize(count);
+
+        size_t begin = 0;
+        for (size_t index = 0; index < count; index++) {
+            vectors[index].iov_base = const_cast<char *>(data + begin);
+            vectors[index].iov_len = ends[index] - begin;
+
+            memset(&messages[index], 0, sizeof(mmsghdr));
+            messages[index].msg_hdr.msg_iov = &vectors[index];
+            messages[index].msg_hdr.msg_iovlen = 1;
+
+            begin = ends[index];
+        }
+
+        count_flush();
+
+        if (!_connected.load() && !connect()) {
+            _dropped.fetch_add(count, std::memory_order_relaxed);
+            count_errors(count);
+            return;
+        }
+
+        mmsghdr *next = messages.data();
+        bool reconnected = false;
+
+        while (count > 0) {
+            int sent = sendmmsg(_socket, next, static_cast<unsigned int>(count), MSG_NOSIGNAL);
+
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+
+                // syslogd was restarted, its socket was recreated
+                if (!reconnected && (errno == ECONNREFUSED || errno == ENOTCONN || errno == ECONNRESET)) {
+                    reconnected = true;
+                    if (connect()) {
+                        continue;
+                    }
+                }
+
+                _dropped.fetch_add(count, std::memory_order_relaxed);
+                count_errors(count);
+                return;
+            }
+
+            _sent.fetch_add(static_cast<unsigned long long>(sent), std::memory_order_relaxed);
+            for (int index = 0; index < sent; index++) {
+                count_bytes(next[index].msg_hdr.msg_iov->iov_len);
+            }
+            next += sent;
+            count -= static_cast<size_t>(sent);
         }
     }
 
     void syslog_sink::set_name(const std::string &name) {
         sink::set_name(name);
-        _pattern = "[L SUBSYS=" + name + "] %s %s";
+        _pattern = "[L SUBSYS=" + name + "] ";
     }
 
 } // namespace logger
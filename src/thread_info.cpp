@@ -0,0 +1,76 @@
+//
+//  thread_info.cpp
+//
+
+#include "logger/thread_info.hpp"
+#include <cstdint>   // uintptr_t
+#include <cstring>   // std::strlen
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h> // SYS_gettid
+#endif
+
+namespace logger {
+
+    // trivial, so that reading it costs no more than any thread_local (no initialization guard)
+    static thread_local thread_info current_info;
+
+    // look up the calling thread's ID and name
+    static void load(thread_info &info) {
+#if defined(__linux__) && defined(SYS_gettid)
+        info.id = syscall(SYS_gettid);
+#else
+        info.id = static_cast<long>(reinterpret_cast<uintptr_t>(pthread_self()));
+#endif
+
+        char digits[THREAD_ID_SIZE];
+        char *first = digits + sizeof(digits);
+        unsigned long value = info.id < 0 ? 0UL - static_cast<unsigned long>(info.id) : static_cast<unsigned long>(info.id);
+        do {
+            *--first = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        if (info.id < 0) {
+            *--first = '-';
+        }
+        info.rendered_id_size = static_cast<size_t>(digits + sizeof(digits) - first);
+        memcpy(info.rendered_id, first, info.rendered_id_size);
+
+        info.name[0] = 0;
+#if defined(__linux__) || defined(__APPLE__)
+        if (pthread_getname_np(pthread_self(), info.name, THREAD_NAME_SIZE) != 0) {
+            info.name[0] = 0;
+        }
+#endif
+        info.name_size = strlen(info.name);
+    }
+
+    // in the child, the forking thread (the only one left) has a new ID
+    static void after_fork() {
+        load(current_info);
+    }
+
+    static const int fork_handler = pthread_atfork(nullptr, nullptr, &after_fork);
+
+    const thread_info &current_thread() {
+        if (current_info.rendered_id_size == 0) {
+            load(current_info);
+        }
+
+        return current_info;
+    }
+
+    void set_thread_name(const std::string &name) {
+        std::string truncated = name.substr(0, THREAD_NAME_SIZE - 1);
+
+#if defined(__linux__)
+        pthread_setname_np(pthread_self(), truncated.c_str());
+#elif defined(__APPLE__)
+        pthread_setname_np(truncated.c_str());
+#endif
+
+        load(current_info);
+    }
+
+} // namespace logger
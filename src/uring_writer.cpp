@@ -0,0 +1,450 @@
+//
+//  uring_writer.cpp
+//
+
+#include "logger/uring_writer.hpp"
+#include <sys/mman.h>    // mmap, munmap
+#include <sys/uio.h>     // writev
+#include <sys/syscall.h> // __NR_io_uring_*
+#include <unistd.h>      // write, close, syscall
+#include <cerrno>
+#include <cstdlib>       // posix_memalign, free
+#include <cstring>       // memcpy, memset
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// raw system calls are used (no liburing), writes at the current file position need IORING_FEAT_RW_CUR_POS (5.6)
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define LOGGER_HAS_IO_URING 1
+#endif
+
+namespace logger {
+
+    static constexpr unsigned long long STOP_REAPER = ~0ULL; //!< user_data of the request that stops the reaper
+
+    uring_writer::uring_writer(int fd, size_t buffer_size, io_backend backend, unsigned int buffers) :
+            _fd(fd),
+            _buffer_size(buffer_size > 0 ? buffer_size : 4096),
+            _current(0),
+            _ready(0),
+            _ring(-1),
+            _fixed(false),
+            _sq_ring(nullptr),
+            _sq_ring_size(0),
+            _cq_ring(nullptr),
+            _cq_ring_size(0),
+            _sqes(nullptr),
+            _sqes_size(0),
+            _sq_head(nullptr),
+            _sq_tail(nullptr),
+            _sq_mask(0),
+            _sq_array(nullptr),
+            _cq_head(nullptr),
+            _cq_tail(nullptr),
+            _cq_mask(0),
+            _cqes(nullptr),
+            _unsubmitted(0),
+            _submissions(0),
+            _errors(0),
+            _bytes(0),
+            _in_flight(0) {
+
+        if (buffers < 2) {
+            buffers = 2;
+        }
+
+        auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        _slots.resize(buffers);
+        _vectors.resize(buffers);
+        for (auto &target : _slots) {
+            void *data = nullptr;
+            if (posix_memalign(&data, page_size, _buffer_size) != 0) {
+                throw sink_exception("uring_writer failed to allocate its buffers");
+            }
+            target.data = static_cast<char *>(data);
+            target.size = 0;
+            target.busy = false;
+        }
+
+        // one entry per buffer and one to stop the reaper
+        if (backend == io_backend::uring && setup(buffers + 1)) {
+            _reaper = std::thread(&uring_writer::reap, this);
+        }
+    }
+
+    uring_writer::~uring_writer() {
+        wait();
+
+#ifdef LOGGER_HAS_IO_URING
+        if (_ring >= 0) {
+            auto *sqes = static_cast<io_uring_sqe *>(_sqes);
+            unsigned int tail = *_sq_tail;
+            io_uring_sqe *sqe = &sqes[tail & _sq_mask];
+
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = STOP_REAPER;
+            _sq_array[tail & _sq_mask] = tail & _sq_mask;
+            __atomic_store_n(_sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+            enter(1);
+            _reaper.join();
+            teardown();
+        }
+#endif
+
+        for (auto &target : _slots) {
+            free(target.data);
+        }
+    }
+
+    bool uring_writer::append(const char *data, size_t size) {
+        bool submitted = false;
+
+        // large lines may span several buffers, they're written in order
+        while (size > 0) {
+            slot &target = _slots[_current];
+            size_t chunk = size < _buffer_size - target.size ? size : _buffer_size - target.size;
+
+            memcpy(target.data + target.size, data, chunk);
+            target.size += chunk;
+            data += chunk;
+            size -= chunk;
+
+            if (target.size == _buffer_size) {
+                _ready++;
+                _current = (_current + 1) % _slots.size();
+
+                // io_uring gets full buffers as soon as the previous batch was reaped, writev waits until it can
+                // gather all of them
+                if ((_ring >= 0 && idle()) || _ready == _slots.size() - 1) {
+                    submit_ready();
+                    submitted = true;
+                }
+                wait_free(_current);
+            }
+        }
+
+        return submitted;
+    }
+
+    void uring_writer::submit() {
+        if (_slots[_current].size > 0) {
+            _ready++;
+            _current = (_current + 1) % _slots.size();
+        }
+
+        if (_ready > 0) {
+            submit_ready();
+            wait_free(_current);
+        }
+    }
+
+    void uring_writer::wait() {
+        submit();
+
+        if (_ring >= 0) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this]() { return _in_flight == 0; });
+        }
+    }
+
+    size_t uring_writer::pending() const {
+        size_t result = _slots[_current].size;
+
+        for (size_t index = 1; index <= _ready; index++) {
+            result += _slots[(_current + _slots.size() - index) % _slots.size()].size;
+        }
+
+        return result;
+    }
+
+    void uring_writer::submit_ready() {
+        size_t first = (_current + _slots.size() - _ready) % _slots.size();
+
+#ifdef LOGGER_HAS_IO_URING
+        if (_ring >= 0) {
+            {
+                // the reaper completes failed or short writes synchronously, a batch submitted before it's done
+                // could reach the file first: only one batch is in flight at a time.
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this]() { return _in_flight == 0; });
+
+                for (size_t index = 0; index < _ready; index++) {
+                    _slots[(first + index) % _slots.size()].busy = true;
+                }
+                _in_flight += _ready;
+            }
+
+            auto *sqes = static_cast<io_uring_sqe *>(_sqes);
+            unsigned int tail = *_sq_tail; // this is the only producer
+
+            for (size_t index = 0; index < _ready; index++) {
+                size_t buffer = (first + index) % _slots.size();
+                io_uring_sqe *sqe = &sqes[tail & _sq_mask];
+
+                memset(sqe, 0, sizeof(*sqe));
+                sqe->opcode = _fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+                sqe->fd = _fd;
+                sqe->addr = reinterpret_cast<unsigned long long>(_slots[buffer].data);
+                sqe->len = static_cast<unsigned int>(_slots[buffer].size);
+                sqe->off = static_cast<unsigned long long>(-1); // current file position
+                sqe->buf_index = static_cast<unsigned short>(_fixed ? buffer : 0);
+                sqe->user_data = buffer;
+
+                // keep this batch in order
+                sqe->flags = static_cast<unsigned char>(index + 1 < _ready ? IOSQE_IO_LINK : 0);
+
+                _sq_array[tail & _sq_mask] = tail & _sq_mask;
+                tail++;
+            }
+
+            __atomic_store_n(_sq_tail, tail, __ATOMIC_RELEASE);
+
+            enter(static_cast<unsigned int>(_ready));
+            _ready = 0;
+            return;
+        }
+#endif
+
+        for (size_t index = 0; index < _ready; index++) {
+            slot &target = _slots[(first + index) % _slots.size()];
+            _vectors[index].iov_base = target.data;
+            _vectors[index].iov_len = target.size;
+        }
+
+        iovec *vector = _vectors.data();
+        int count = static_cast<int>(_ready);
+
+        while (count > 0) {
+            ssize_t written = writev(_fd, vector, count);
+            _submissions.fetch_add(1, std::memory_order_relaxed);
+
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                _errors.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            _bytes.fetch_add(static_cast<unsigned long long>(written), std::memory_order_relaxed);
+
+            // skip what was written (short writes)
+            auto remaining = static_cast<size_t>(written);
+            while (count > 0 && remaining >= vector->iov_len) {
+                remaining -= vector->iov_len;
+                vector++;
+                count--;
+            }
+            if (count > 0) {
+                vector->iov_base = static_cast<char *>(vector->iov_base) + remaining;
+                vector->iov_len -= remaining;
+            }
+        }
+
+        for (size_t index = 0; index < _ready; index++) {
+            _slots[(first + index) % _slots.size()].size = 0;
+        }
+        _ready = 0;
+    }
+
+    void uring_writer::enter(unsigned int count) {
+#ifdef LOGGER_HAS_IO_URING
+        _unsubmitted += count;
+
+        while (_unsubmitted > 0) {
+            long consumed = syscall(__NR_io_uring_enter, _ring, _unsubmitted, 0, 0, nullptr, 0);
+            _submissions.fetch_add(1, std::memory_order_relaxed);
+
+            if (consumed < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // the entries stay in the ring, they're submitted with the next ones
+                return;
+            }
+            _unsubmitted -= static_cast<unsigned int>(consumed);
+        }
+#else
+        (void) count;
+#endif
+    }
+
+    bool uring_writer::idle() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _in_flight == 0;
+    }
+
+    void uring_writer::wait_free(size_t index) {
+        if (_ring >= 0) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _condition.wait(lock, [this, index]() { return !_slots[index].busy; });
+        }
+    }
+
+    size_t uring_writer::write_all(const char *data, size_t size) {
+        size_t total = 0;
+
+        while (size > 0) {
+            ssize_t written = ::write(_fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+            total += static_cast<size_t>(written);
+        }
+
+        return total;
+    }
+
+    bool uring_writer::setup(unsigned int entries) {
+#ifdef LOGGER_HAS_IO_URING
+        io_uring_params params{};
+        int ring = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring < 0) {
+            return false;
+        }
+
+        // IORING_OP_WRITE and writes at the current position (needed by pipes, terminals and O_APPEND files)
+        if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+            ::close(ring);
+            return false;
+        }
+
+        _ring = ring;
+        _sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        _cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            _sq_ring_size = _cq_ring_size = (_sq_ring_size > _cq_ring_size ? _sq_ring_size : _cq_ring_size);
+        }
+
+        void *sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED) {
+            teardown();
+            return false;
+        }
+        _sq_ring = sq_ring;
+
+        if (single_mmap) {
+            _cq_ring = _sq_ring;
+        } else {
+            void *cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED) {
+                teardown();
+                return false;
+            }
+            _cq_ring = cq_ring;
+        }
+
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            teardown();
+            return false;
+        }
+        _sqes = sqes;
+
+        auto *sq = static_cast<char *>(_sq_ring);
+        _sq_head = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+        _sq_tail = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+        _sq_mask = *reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+
+        auto *cq = static_cast<char *>(_cq_ring);
+        _cq_head = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+        _cq_mask = *reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+        _cqes = cq + params.cq_off.cqes;
+
+        // fixed buffers save the kernel from mapping the pages on each write, registration may fail (RLIMIT_MEMLOCK)
+        for (size_t index = 0; index < _slots.size(); index++) {
+            _vectors[index].iov_base = _slots[index].data;
+            _vectors[index].iov_len = _buffer_size;
+        }
+        _fixed = syscall(__NR_io_uring_register, ring, IORING_REGISTER_BUFFERS, _vectors.data(), static_cast<unsigned int>(_slots.size())) == 0;
+
+        return true;
+#else
+        (void) entries;
+        return false;
+#endif
+    }
+
+    void uring_writer::teardown() {
+        if (_sqes != nullptr) {
+            munmap(_sqes, _sqes_size);
+        }
+        if (_cq_ring != nullptr && _cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_ring_size);
+        }
+        if (_sq_ring != nullptr) {
+            munmap(_sq_ring, _sq_ring_size);
+        }
+        ::close(_ring); // registered buffers are released with the ring
+
+        _sqes = _cq_ring = _sq_ring = nullptr;
+        _ring = -1;
+        _fixed = false;
+    }
+
+    void uring_writer::reap() {
+#ifdef LOGGER_HAS_IO_URING
+        auto *cqes = static_cast<io_uring_cqe *>(_cqes);
+        bool running = true;
+
+        while (running) {
+            unsigned int head = *_cq_head; // this is the only consumer
+            unsigned int tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+
+            if (head == tail) {
+                syscall(__NR_io_uring_enter, _ring, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                continue;
+            }
+
+            for (; head != tail; head++) {
+                const io_uring_cqe &completion = cqes[head & _cq_mask];
+
+                if (completion.user_data == STOP_REAPER) {
+                    running = false;
+                    continue;
+                }
+
+                slot &target = _slots[completion.user_data];
+                size_t written = completion.res > 0 ? static_cast<size_t>(completion.res) : 0;
+
+                // failed, short or canceled (a linked write failed) write: write the rest synchronously. The next
+                // batch is only submitted once this one was reaped, so it can't get ahead of it.
+                if (written < target.size) {
+                    written += write_all(target.data + written, target.size - written);
+                    if (written < target.size) {
+                        _errors.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+                _bytes.fetch_add(written, std::memory_order_relaxed);
+
+                {
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    target.size = 0;
+                    target.busy = false;
+                    _in_flight--;
+                }
+                _condition.notify_all();
+            }
+
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+        }
+#endif
+    }
+
+} // namespace logger
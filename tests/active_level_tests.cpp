@@ -0,0 +1,38 @@
+/** compile-time log level threshold tests.
+ *
+ * This program is built with CPP_LOGGER_ACTIVE_LEVEL set to LOG_INFO (see tests/CMakeLists.txt).
+ */
+#include <logger/cpp-logger.hpp>
+#include "gtest/gtest.h"
+
+TEST(active_level, threshold) {
+    EXPECT_EQ(logger::ACTIVE_LOG_LEVEL, logger::LOG_INFO);
+}
+
+TEST(active_level, compiled_out) {
+    logger::logger_ptr out = logger::get<logger::stdout_sink>("active-level-logger");
+    out->set_log_level(logger::log_level::trace);
+
+    ::testing::internal::CaptureStdout();
+    out->trace("trace is compiled out (%s)", "not written");
+    out->debug("debug is compiled out (%s)", "not written");
+    out->info("info is still active (%s)", "written");
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(output.find("not written"), std::string::npos);
+    EXPECT_NE(output.find("[L SUBSYS=active-level-logger] info is still active (written)\n"), std::string::npos);
+}
+
+TEST(active_level, runtime_level) {
+    logger::logger_ptr out = logger::get<logger::stdout_sink>("active-level-logger");
+    out->set_log_level(logger::log_level::warning);
+
+    ::testing::internal::CaptureStdout();
+    out->info("info is filtered at runtime (%s)", "not written");
+    out->log(logger::log_level::info, std::string("info is filtered at runtime (%s)"), "not written");
+    out->warning("warning is written");
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(output.find("not written"), std::string::npos);
+    EXPECT_NE(output.find("warning is written"), std::string::npos);
+}
@@ -0,0 +1,159 @@
+/** binary sink tests.
+ *
+ * It's used to check that binary log files are decoded into the usual layout.
+ */
+#include <logger/cpp-logger.hpp>
+#include "gtest/gtest.h"
+#include <thread>
+#include <vector>
+
+/** decode a binary log file and return the messages (what comes after the subsystem) */
+std::vector<std::string> decode(FILE *file){
+    std::vector<std::string> messages;
+
+    rewind(file);
+    logger::binary_decoder decoder(file);
+    logger::buffer line;
+
+    while (decoder.next(line)) {
+        std::string text(line.data(), line.size());
+        auto pos = text.find("[L SUBSYS");
+        messages.push_back(pos != std::string::npos ? text.substr(pos) : text);
+    }
+
+    return messages;
+}
+
+TEST(binary_sink, printf_records) {
+    FILE *file = tmpfile();
+    {
+        logger::binary_sink sink("binary-printf", "app", logger::log_level::info, file);
+
+        sink.write(logger::log_level::info, "order %d placed in %.1f us", 42, 12.5);
+        sink.write(logger::log_level::debug, "filtered %s", "out");
+        sink.set_ecid("binary-ecid");
+        sink.write(logger::log_level::err, "no end-of-line\n");
+    }
+
+    auto messages = decode(file);
+    ASSERT_EQ(messages.size(), 2);
+    EXPECT_EQ(messages[0], "[L SUBSYS=binary-printf] order 42 placed in 12.5 us\n");
+    EXPECT_EQ(messages[1], "[L SUBSYS=binary-printf] no end-of-line\n");
+
+    fclose(file);
+}
+
+TEST(binary_sink, ecid_guard) {
+    FILE *file = tmpfile();
+    {
+        logger::binary_sink sink("binary-ecid", "app", logger::log_level::info, file);
+        sink.set_ecid("sink-ecid");
+        {
+            logger::ecid_guard guard("request-1");
+            sink.write(logger::log_level::info, "scoped");
+        }
+        sink.write(logger::log_level::info, "not scoped");
+    }
+
+    rewind(file);
+    logger::binary_decoder decoder(file);
+    logger::buffer line;
+
+    ASSERT_TRUE(decoder.next(line));
+    EXPECT_NE(std::string(line.data()).find("[M ECID=\"request-1\"][L SUBSYS=binary-ecid] scoped\n"), std::string::npos);
+    ASSERT_TRUE(decoder.next(line));
+    EXPECT_NE(std::string(line.data()).find("[M ECID=\"sink-ecid\"][L SUBSYS=binary-ecid] not scoped\n"), std::string::npos);
+    EXPECT_FALSE(decoder.next(line));
+
+    fclose(file);
+}
+
+TEST(binary_sink, not_a_binary_file) {
+    FILE *file = tmpfile();
+    fputs("<6>1 this is text", file);
+    rewind(file);
+
+    EXPECT_THROW(logger::binary_decoder decoder(file), logger::sink_exception);
+
+    fclose(file);
+}
+
+#if __cplusplus >= 201402L
+
+TEST(binary_sink, format_records) {
+    FILE *file = tmpfile();
+    {
+        logger::binary_sink sink("binary-format", "app", logger::log_level::info, file);
+        std::string text{"text"};
+
+        for (int count = 0; count < 2; count++) {
+            sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("order {} placed in {} us"), 42 + count, 12.5));
+        }
+        sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("{} {} {} {} {{{}}}"), text, 'c', true, -1LL, 18446744073709551615ULL));
+        sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("{}"), static_cast<const void *>(nullptr)));
+        sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("no argument")));
+        sink.flush();
+
+        EXPECT_EQ(sink.dropped(), 0);
+    }
+
+    auto messages = decode(file);
+    ASSERT_EQ(messages.size(), 5);
+    EXPECT_EQ(messages[0], "[L SUBSYS=binary-format] order 42 placed in 12.5 us\n");
+    EXPECT_EQ(messages[1], "[L SUBSYS=binary-format] order 43 placed in 12.5 us\n");
+    EXPECT_EQ(messages[2], "[L SUBSYS=binary-format] text c true -1 {18446744073709551615}\n");
+    EXPECT_EQ(messages[3], "[L SUBSYS=binary-format] (nil)\n");
+    EXPECT_EQ(messages[4], "[L SUBSYS=binary-format] no argument\n");
+
+    fclose(file);
+}
+
+TEST(binary_sink, logger) {
+    FILE *file = tmpfile();
+    {
+        logger::logger_ptr log = logger::get<logger::binary_sink>("binary-test-logger", file);
+
+        log->info(LOGGER_FORMAT("order {} placed in {} us"), 42, 12.5);
+        log->debug(LOGGER_FORMAT("filtered {}"), "out");
+
+        logger::registry::instance().remove("binary-test-logger");
+    }
+
+    auto messages = decode(file);
+    ASSERT_EQ(messages.size(), 1);
+    EXPECT_EQ(messages[0], "[L SUBSYS=binary-test-logger] order 42 placed in 12.5 us\n");
+
+    fclose(file);
+}
+
+TEST(binary_sink, threads) {
+    FILE *file = tmpfile();
+    const int threads = 4;
+    const int messages_per_thread = 1000;
+    {
+        logger::binary_sink sink("binary-threads", "app", logger::log_level::info, file);
+        std::vector<std::thread> workers;
+
+        for (int id = 0; id < threads; id++) {
+            workers.emplace_back([&sink, id]() {
+                for (int count = 0; count < messages_per_thread; count++) {
+                    sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("thread {} message {}"), id, count));
+                }
+            });
+        }
+
+        // threads exit before the sink is flushed, their records must not be lost.
+        for (auto &worker : workers) {
+            worker.join();
+        }
+
+        EXPECT_EQ(sink.dropped(), 0);
+    }
+
+    auto messages = decode(file);
+    EXPECT_EQ(messages.size(), threads * messages_per_thread);
+
+    fclose(file);
+}
+
+#endif
@@ -0,0 +1,114 @@
+/** compile-time format strings tests.
+ *
+ * It's used to check that LOGGER_FORMAT strings are parsed and rendered as expected.
+ */
+#include <logger/cpp-logger.hpp>
+#include "gtest/gtest.h"
+
+#if __cplusplus >= 201402L
+
+/** renders a message into a string */
+std::string render(const logger::message &msg){
+    logger::buffer out;
+    msg.render(out);
+
+    return std::string(out.data(), out.size());
+}
+
+namespace shop {
+    struct order {
+        int id;
+    };
+
+    /** sample formatter of a user type (found by ADL) */
+    void format_value(logger::buffer &out, const order &value){
+        out.append("order#", 6);
+        logger::format_value(out, value.id);
+    }
+}
+
+TEST(format, parse) {
+    auto fmt = LOGGER_FORMAT("order {} placed in {} us");
+
+    static_assert(decltype(fmt)::arguments == 2, "two arguments expected");
+    static_assert(decltype(fmt)::size == 5, "five segments expected"); // "order ", {}, " placed in ", {}, " us"
+    static_assert(decltype(fmt)::segments.items[1].argument, "second segment is an argument");
+
+    EXPECT_STREQ(decltype(fmt)::string(), "order {} placed in {} us");
+}
+
+TEST(format, render) {
+    int id = 42;
+    double latency = 12.5;
+
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("order {} placed in {} us"), id, latency)), "order 42 placed in 12.5 us");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("{}{}"), 'a', "b")), "ab");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("no argument"))), "no argument");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT(""))), "");
+}
+
+TEST(format, escaped_braces) {
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("{{{}}}"), 1)), "{1}");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("set {{a, b}} has {} items"), 2)), "set {a, b} has 2 items");
+}
+
+TEST(format, values) {
+    std::string text{"text"};
+    const char *null_string = nullptr;
+
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("{} {} {}"), text, null_string, true)), "text (null) true");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("{} {} {}"), -1, 0u, -9223372036854775807LL - 1)), "-1 0 -9223372036854775808");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("{} {}"), 18446744073709551615ULL, static_cast<short>(-3))), "18446744073709551615 -3");
+    EXPECT_EQ(render(logger::make_message(LOGGER_FORMAT("{}"), shop::order{7})), "order#7");
+}
+
+TEST(format, stdout_sink) {
+    logger::logger_ptr out = logger::get<logger::stdout_sink>("format-test-logger");
+
+    ::testing::internal::CaptureStdout();
+    out->info(LOGGER_FORMAT("order {} placed in {} us"), 42, 12.5);
+    out->debug(LOGGER_FORMAT("filtered {}"), "out");
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    auto pos = output.rfind("[L SUBSYS");
+    EXPECT_EQ("[L SUBSYS=format-test-logger] order 42 placed in 12.5 us\n", ( pos != std::string::npos ? output.substr(pos) : "pattern \"[L SUBSYS\" not found"));
+}
+
+TEST(format, async_sink) {
+    logger::async_sink<logger::stdout_sink> sink("format-async", "app", logger::log_level::info);
+
+    ::testing::internal::CaptureStdout();
+    sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("order {} placed in {} us"), 42, 12.5));
+    sink.flush();
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    auto pos = output.rfind("[L SUBSYS");
+    EXPECT_EQ("[L SUBSYS=format-async] order 42 placed in 12.5 us\n", ( pos != std::string::npos ? output.substr(pos) : "pattern \"[L SUBSYS\" not found"));
+}
+
+/** a sink that only knows about printf like messages */
+class printf_only_sink: public logger::sink {
+public:
+    printf_only_sink(): logger::sink("printf-only", "app", logger::log_level::info) {
+        // intentional
+    }
+
+    void write(logger::log_level, const char *fmt, ...) override {
+        va_list args;
+        va_start(args, fmt);
+        _output.vprintf(fmt, args);
+        va_end(args);
+    }
+
+    logger::buffer _output;
+};
+
+TEST(format, custom_sink) {
+    printf_only_sink sink;
+
+    sink.emit(logger::log_level::info, logger::make_message(LOGGER_FORMAT("{} is {}%"), "ratio", 50));
+
+    EXPECT_STREQ(sink._output.data(), "ratio is 50%"); // rendered once, and passed as %s
+}
+
+#endif
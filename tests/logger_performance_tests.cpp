@@ -1,11 +1,17 @@
 /** simple test program.
  *
- * It's used to check that the library is working as expected.
+ * It's used to check that the library is working as expected. Wall clock durations are only printed, per call costs
+ * and latencies are measured by the micro benchmarks (see ./benchmarks).
  */
 #include <logger/cpp-logger.hpp>
 #include <unistd.h>
 #include <libgen.h>
+#include <sys/time.h>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 const std::string PNAME{"performance"};
 
@@ -45,8 +51,6 @@ TEST(logger_performance, default) {
     auto duration = run(main_logger, loop);
 
     std::cout << "called " << loop << " time logger->info(...) in " << duration << " milliseconds." << std::endl;
-
-    EXPECT_LT(duration, 6000);
 }
 
 TEST(logger_performance, stdout_sink) {
@@ -64,8 +68,6 @@ TEST(logger_performance, stdout_sink) {
     auto duration = run(stdout_logger, loop);
 
     std::cout << "called " << loop << " time logger->info(...) in " << duration << " milliseconds." << std::endl;
-
-    EXPECT_LT(duration, 6000);
 }
 
 TEST(logger_performance, stderr_sink) {
@@ -83,8 +85,42 @@ TEST(logger_performance, stderr_sink) {
     auto duration = run(stdout_logger, loop);
 
     std::cout << "called " << loop << " time logger->info(...) in " << duration << " milliseconds." << std::endl;
+}
+
+TEST(logger_performance, file_sink) {
+    FILE *devnull = fopen("/dev/null", "w");
+    ASSERT_NE(devnull, nullptr);
+
+    logger::set_program_name(PNAME);
+    logger::logger_ptr file_logger = logger::get<logger::file_sink>("file", devnull);
+
+    int loop = 100000;
+
+    auto duration = run(file_logger, loop);
+
+    std::cout << "called " << loop << " time logger->info(...) in " << duration << " milliseconds ("
+              << (duration > 0 ? (loop * 1000LL) / duration : loop * 1000LL) << " messages/s)." << std::endl;
 
-    EXPECT_LT(duration, 6000);
+    logger::registry::instance().remove("file");
+    fclose(devnull);
+}
+
+TEST(logger_performance, file_sink_buffered) {
+    FILE *devnull = fopen("/dev/null", "w");
+    ASSERT_NE(devnull, nullptr);
+
+    logger::set_program_name(PNAME);
+    logger::logger_ptr file_logger = logger::get<logger::file_sink>("file-buffered", devnull, logger::flush_policy(64, 100));
+
+    int loop = 100000;
+
+    auto duration = run(file_logger, loop);
+
+    std::cout << "called " << loop << " time logger->info(...) in " << duration << " milliseconds ("
+              << (duration > 0 ? (loop * 1000LL) / duration : loop * 1000LL) << " messages/s, 64KB buffer)." << std::endl;
+
+    logger::registry::instance().remove("file-buffered");
+    fclose(devnull);
 }
 
 TEST(logger_performance, syslog_sink) {
@@ -102,6 +138,168 @@ TEST(logger_performance, syslog_sink) {
     auto duration = run(stdout_logger, loop);
 
     std::cout << "called " << loop << " time logger->info(...) in " << duration << " milliseconds." << std::endl;
+}
+
+/** gives access to the file_sink::date_time methods and provides the per call implementation they replaced.
+ */
+class date_time_sink: public logger::file_sink {
+public:
+    date_time_sink(): logger::file_sink("date-time", "performance", logger::log_level::info, stdout){
+        // intentional
+    }
+
+    size_t cached_date_time(char *target, size_t size){
+        return date_time(target, size);
+    }
+
+    std::string cached_date_time(){
+        return date_time();
+    }
+
+    /** gettimeofday, localtime_r and a full snprintf on every call (this is how it was done up to v2.2.7) */
+    size_t uncached_date_time(char *target, size_t size){
+        timeval current_time{0};
+        gettimeofday(&current_time, nullptr);
+
+        struct std::tm local_time{0};
+        localtime_r(&current_time.tv_sec, &local_time);
+
+        return snprintf(target, size - 1, "%d-%02d-%02dT%02d:%02d:%02d.%06d%s",
+                 local_time.tm_year + 1900,
+                 local_time.tm_mon + 1,
+                 local_time.tm_mday,
+                 local_time.tm_hour,
+                 local_time.tm_min,
+                 local_time.tm_sec,
+                 static_cast<int>(current_time.tv_usec),
+                 "+00:00");
+    }
+};
+
+TEST(logger_performance, date_time) {
+    date_time_sink sink;
+    char buffer[logger::DATE_TIME_SIZE];
+    int loop = 1000000;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto x = loop; x > 0; x--) {
+        sink.uncached_date_time(buffer, sizeof(buffer));
+    }
+    auto uncached = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (auto x = loop; x > 0; x--) {
+        sink.cached_date_time(buffer, sizeof(buffer));
+    }
+    auto cached = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
 
-    EXPECT_LT(duration, 5);
-}
\ No newline at end of file
+    std::cout << "date_time: " << buffer << std::endl
+              << "  per call formatting: " << (uncached / loop) << " ns/call" << std::endl
+              << "  per second cache   : " << (cached / loop) << " ns/call" << std::endl;
+
+    // timings are only printed, wall clock noise makes them unfit for an assertion (see the file_sink_header benchmarks)
+    EXPECT_EQ(strlen(buffer), sink.cached_date_time().size());
+}
+
+TEST(logger_performance, ecid) {
+    logger::stdout_sink sink("ecid", "performance", logger::log_level::info);
+    sink.set_ecid("0123456789012345678901234567890123456789");
+
+    const int threads = 32;
+    const int loop = 100000;
+    std::atomic<bool> running{true};
+    std::vector<std::thread> readers;
+
+    // one thread keeps changing the ECID while the others read it
+    std::thread writer([&sink, &running]() {
+        for (int x = 0; running.load(); x++) {
+            sink.set_ecid(x % 2 == 0 ? "even-0123456789012345678901234567890123456789" : "odd-0123456789012345678901234567890123456789");
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    });
+
+    std::atomic<int> torn{0};
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int id = 0; id < threads; id++) {
+        readers.emplace_back([&sink, &torn]() {
+            char ecid[logger::ECID_SIZE];
+            for (auto x = loop; x > 0; x--) {
+                size_t size = sink.ecid(ecid, sizeof(ecid));
+                if (ecid[size - 1] != ']' || (strncmp(ecid, "[M ECID=\"even-", 14) != 0 && strncmp(ecid, "[M ECID=\"odd-", 13) != 0 && strncmp(ecid, "[M ECID=\"0123", 13) != 0)) {
+                    torn++;
+                }
+            }
+        });
+    }
+
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    running.store(false);
+    writer.join();
+
+    std::cout << threads << " threads read the ECID " << loop << " times each: "
+              << (duration / (static_cast<long long>(threads) * loop)) << " ns/read (wall clock)." << std::endl;
+
+    EXPECT_EQ(torn.load(), 0);
+}
+
+TEST(logger_performance, registry_lookup) {
+    logger::logger_ptr expected = logger::get("lookup");
+    const int loop = 200000;
+
+    for (int threads = 1; threads <= 8; threads *= 2) {
+        std::vector<std::thread> workers;
+        std::atomic<int> mismatches{0};
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (int id = 0; id < threads; id++) {
+            workers.emplace_back([&expected, &mismatches]() {
+                for (auto x = loop; x > 0; x--) {
+                    if (logger::get("lookup") != expected) {
+                        mismatches++;
+                    }
+                }
+            });
+        }
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::cout << threads << " thread(s) looked up a logger " << loop << " times each: "
+                  << ((static_cast<long long>(threads) * loop * 1000000000LL) / (duration > 0 ? duration : 1)) << " lookups/s." << std::endl;
+
+        EXPECT_EQ(mismatches.load(), 0);
+    }
+}
+
+TEST(logger_performance, rate_limited_storm) {
+    FILE *devnull = fopen("/dev/null", "w");
+    ASSERT_NE(devnull, nullptr);
+
+    logger::logger_ptr storm = logger::get<logger::file_sink>("rate-limited", devnull);
+    storm->set_rate_limit(logger::rate_limit(10, 1));
+
+    const int loop = 1000000;
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int x = 0; x < loop; x++) {
+        storm->err("dependency is down (attempt %d)", x);
+    }
+
+    auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "called " << loop << " time logger->err(...) on a rate limited call site: "
+              << duration / loop << " ns per call, " << storm->suppressed() << " messages suppressed." << std::endl;
+
+    EXPECT_GE(storm->suppressed(), static_cast<unsigned long long>(loop - 20));
+
+    logger::registry::instance().remove("rate-limited");
+    fclose(devnull);
+}
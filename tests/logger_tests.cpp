@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <syslog.h>
 #include "gtest/gtest.h"
+#include <thread>
 
 TEST(registry, unicity_check) {
     logger::logger_ptr err0 = logger::get<logger::stderr_sink>("stderr-test-logger");
@@ -83,6 +84,36 @@ TEST(registry, get_syslog_sink) {
     local1_log->info("sent by cpp-logger");
 }
 
+TEST(registry, get_async_sink) {
+    logger::logger_ptr out = logger::get<logger::async_sink<logger::stdout_sink>>("async-test-logger");
+
+    EXPECT_NE(out, nullptr);
+    EXPECT_EQ(out->name(), "async-test-logger");
+    EXPECT_EQ(out->level(), logger::registry::instance().level());
+
+    out->info("async sink test (a word: %s)", "hello, world");
+}
+
+TEST(registry, remove_and_get) {
+    logger::logger_ptr first = logger::get("removed-test-logger");
+    EXPECT_EQ(logger::get("removed-test-logger"), first); // found without locking this time
+
+    std::weak_ptr<logger::logger> removed = first;
+    logger::registry::instance().remove("removed-test-logger");
+    first.reset();
+
+    EXPECT_TRUE(removed.expired()); // threads don't keep removed loggers alive
+
+    logger::logger_ptr second = logger::get("removed-test-logger");
+    EXPECT_NE(second, nullptr);
+    EXPECT_EQ(logger::get("removed-test-logger"), second);
+
+    // other threads see the new instance
+    logger::logger_ptr other;
+    std::thread([&other]() { other = logger::get("removed-test-logger"); }).join();
+    EXPECT_EQ(other, second);
+}
+
 TEST(logger, change_log_level) {
     logger::logger_ptr err = logger::get<logger::stdout_sink>("stderr-test-logger");
     EXPECT_NE(err, nullptr);
@@ -137,3 +168,312 @@ TEST(logger, stdout_logger) {
 
     EXPECT_EQ("[L SUBSYS=logger-name] stdout sink test, name: logger-name\n", output.substr(pos));
 }
+
+/** @return the content of a FILE */
+static std::string read_file(FILE *file) {
+    fflush(file);
+    rewind(file);
+
+    std::string content;
+    for (int c = fgetc(file); c != EOF; c = fgetc(file)) {
+        content += static_cast<char>(c);
+    }
+    fseek(file, 0, SEEK_END);
+
+    return content;
+}
+
+/** @return number of occurrences of pattern in content */
+static size_t count(const std::string &content, const std::string &pattern) {
+    size_t found = 0;
+    for (size_t pos = content.find(pattern); pos != std::string::npos; pos = content.find(pattern, pos + pattern.size())) {
+        found++;
+    }
+
+    return found;
+}
+
+TEST(logger, rate_limit) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    std::string name { "rate-limited"};
+    logger::logger_ptr logger{ new logger::logger{ name, new logger::file_sink(name, "program", logger::log_level::info, file) } };
+
+    // 5 messages in a row, then one every 50ms (per call site)
+    logger->set_rate_limit(logger::rate_limit(5, 20));
+
+    // one call site
+    auto retry = [&logger](int attempt) {
+        logger->err("dependency is down (attempt %d)", attempt);
+    };
+
+    for (auto x = 0; x < 1000; x++) {
+        retry(x);
+    }
+    logger->info("another call site is not limited");
+
+    EXPECT_EQ(logger->suppressed(), 995);
+
+    std::string content = read_file(file);
+    EXPECT_NE(content.find("(attempt 4)"), std::string::npos);
+    EXPECT_EQ(content.find("(attempt 5)"), std::string::npos);
+    EXPECT_NE(content.find("another call site is not limited"), std::string::npos);
+
+    // the bucket is refilled, the next message gets through with a summary
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    retry(1000);
+
+    content = read_file(file);
+    EXPECT_NE(content.find("suppressed 995 similar messages in last 1s"), std::string::npos);
+    EXPECT_NE(content.find("(attempt 1000)"), std::string::npos);
+
+    // rate limiting can be turned off
+    logger->set_rate_limit(logger::rate_limit());
+    for (auto x = 0; x < 10; x++) {
+        logger->warning("not limited anymore");
+    }
+    EXPECT_EQ(logger->suppressed(), 995);
+
+    logger.reset();
+    fclose(file);
+}
+
+TEST(logger, rate_limit_pending_summaries) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    std::string name { "storm"};
+    logger::logger_ptr logger{ new logger::logger{ name, new logger::file_sink(name, "program", logger::log_level::info, file) } };
+    logger->set_rate_limit(logger::rate_limit(5, 1));
+
+    // the storm stops, no message of the call site gets through to carry the summary
+    for (auto x = 0; x < 100; x++) {
+        logger->err("first storm (%d)", x);
+    }
+    EXPECT_EQ(logger->suppressed(), 95);
+
+    logger->report_suppressed();
+    std::string content = read_file(file);
+    EXPECT_EQ(count(content, "suppressed 95 similar messages"), 1);
+
+    // nothing new to report
+    logger->report_suppressed();
+    EXPECT_EQ(count(read_file(file), "suppressed"), 1);
+
+    // the logger writes what's pending when it is destroyed
+    for (auto x = 0; x < 10; x++) {
+        logger->warning("second storm (%d)", x);
+    }
+    EXPECT_EQ(logger->suppressed(), 100);
+
+    logger.reset();
+    EXPECT_EQ(count(read_file(file), "suppressed 5 similar messages"), 1);
+    fclose(file);
+}
+
+TEST(logger, sampling) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    std::string name { "sampled"};
+    logger::logger_ptr logger{ new logger::logger{ name, new logger::file_sink(name, "program", logger::log_level::info, file) } };
+
+    // 1 debug message in 10, other levels are not sampled
+    logger->set_log_level(logger::log_level::debug, logger::sampling::one_in(10));
+    EXPECT_EQ(logger->level(), logger::log_level::debug);
+    EXPECT_EQ(logger->sampling_of(logger::log_level::debug).every, 10);
+
+    for (auto x = 0; x < 100; x++) {
+        logger->debug("debug message %d", x);
+        logger->info("info message %d", x);
+    }
+
+    std::string content = read_file(file);
+    EXPECT_EQ(count(content, "[S RATE=\"0.1\"] debug message"), 10);
+    EXPECT_EQ(count(content, "debug message"), 10);
+    EXPECT_EQ(count(content, "info message"), 100);
+    EXPECT_EQ(count(content, "[S RATE="), 10);
+
+    // 50% of trace messages
+    logger->set_log_level(logger::log_level::trace, logger::sampling::percent(50));
+    EXPECT_DOUBLE_EQ(logger->sampling_of(logger::log_level::trace).rate(), 0.5);
+
+    for (auto x = 0; x < 10000; x++) {
+        logger->trace("trace message %d", x);
+    }
+
+    content = read_file(file);
+    size_t traced = count(content, "[S RATE=\"0.5\"] trace message");
+    EXPECT_GT(traced, 4000);
+    EXPECT_LT(traced, 6000);
+
+    // nothing, then everything
+    logger->set_sampling(logger::log_level::debug, logger::sampling::percent(0));
+    logger->debug("never written");
+    logger->set_sampling(logger::log_level::debug, logger::sampling());
+    logger->debug("always written");
+
+    content = read_file(file);
+    EXPECT_EQ(content.find("never written"), std::string::npos);
+    EXPECT_NE(content.find("] always written"), std::string::npos);
+    EXPECT_EQ(content.find("[S RATE=\"1\"]"), std::string::npos);
+
+    logger.reset();
+    fclose(file);
+}
+
+TEST(logger, sampling_per_logger) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    logger::logger_ptr first{ new logger::logger{ "first", new logger::file_sink("first", "program", logger::log_level::info, file) } };
+    logger::logger_ptr second{ new logger::logger{ "second", new logger::file_sink("second", "program", logger::log_level::info, file) } };
+    first->set_log_level(logger::log_level::debug, logger::sampling::one_in(2));
+    second->set_log_level(logger::log_level::debug, logger::sampling::one_in(2));
+
+    // interleaved on the same thread, each logger counts its own messages
+    for (auto x = 0; x < 10; x++) {
+        first->debug("first message %d", x);
+        second->debug("second message %d", x);
+    }
+
+    std::string content = read_file(file);
+    EXPECT_EQ(count(content, "first message"), 5);
+    EXPECT_EQ(count(content, "second message"), 5);
+
+    first.reset();
+    second.reset();
+    fclose(file);
+}
+
+TEST(registry, set_sampling) {
+    logger::logger_ptr before = logger::get<logger::stdout_sink>("sampled-before");
+
+    logger::set_level(logger::log_level::debug, logger::sampling::one_in(4));
+    logger::logger_ptr after = logger::get<logger::stdout_sink>("sampled-after");
+
+    EXPECT_EQ(before->level(), logger::log_level::debug);
+    EXPECT_EQ(before->sampling_of(logger::log_level::debug).every, 4);
+    EXPECT_EQ(after->sampling_of(logger::log_level::debug).every, 4);
+    EXPECT_EQ(after->sampling_of(logger::log_level::info).every, 1);
+
+    ::testing::internal::CaptureStdout();
+    for (auto x = 0; x < 8; x++) {
+        after->debug("sampled debug message");
+    }
+    std::string output = ::testing::internal::GetCapturedStdout();
+    EXPECT_EQ(count(output, "[S RATE=\"0.25\"] sampled debug message"), 2);
+
+    // back to defaults
+    logger::set_sampling(logger::log_level::debug, logger::sampling());
+    logger::set_level(logger::log_level::info);
+    EXPECT_EQ(after->sampling_of(logger::log_level::debug).every, 1);
+
+    logger::registry::instance().remove("sampled-before");
+    logger::registry::instance().remove("sampled-after");
+}
+
+TEST(logger, key_value_fields) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    std::string name { "fields"};
+    logger::logger_ptr logger{ new logger::logger{ name, new logger::file_sink(name, "program", logger::log_level::info, file) } };
+
+    using logger::kv;
+
+    long order_id = 4242;
+    std::string customer { "acme \"north\" [eu]" };
+    logger->info("order placed", kv("order_id", order_id), kv("latency_us", 17.5), kv("customer", customer), kv("paid", true));
+    logger->warning(std::string("odd names"), kv("bad name=\"x\"]", 'c'), kv("", "empty"), kv("path", "c:\\tmp"));
+    logger->debug("not written", kv("key", 1));
+
+    std::string content = read_file(file);
+    EXPECT_NE(content.find("[L SUBSYS=fields] [F order_id=\"4242\" latency_us=\"17.5\" customer=\"acme \\\"north\\\" [eu\\]\" paid=\"true\"] order placed\n"), std::string::npos);
+    EXPECT_NE(content.find("[F bad_name__x__=\"c\" _=\"empty\" path=\"c:\\\\tmp\"] odd names\n"), std::string::npos);
+    EXPECT_EQ(content.find("not written"), std::string::npos);
+
+    // fields and sampling
+    logger->set_log_level(logger::log_level::debug, logger::sampling::one_in(2));
+    logger->debug("sampled", kv("step", 1));
+    logger->debug("sampled", kv("step", 2));
+
+    content = read_file(file);
+    EXPECT_NE(content.find("[S RATE=\"0.5\"] [F step=\"1\"] sampled\n"), std::string::npos);
+    EXPECT_EQ(content.find("step=\"2\""), std::string::npos);
+
+    logger.reset();
+    fclose(file);
+}
+
+TEST(registry, metrics) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    logger::logger_ptr logger = logger::get<logger::file_sink>("metrics", file);
+
+    for (auto x = 0; x < 10; x++) {
+        logger->info("accepted message #%d", x);
+        logger->debug("filtered message #%d", x);
+    }
+    logger->err("severe messages flush the file");
+
+    std::vector<std::thread> threads;
+    for (auto t = 0; t < 4; t++) {
+        threads.emplace_back([&logger]() {
+            for (auto x = 0; x < 100; x++) {
+                logger->info("accepted message #%d", x);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    logger::sink_metrics found;
+    logger::sink_metrics total;
+    for (auto &current : logger::metrics()) {
+        if (current.name == "metrics") {
+            found = current;
+        }
+        total += current;
+    }
+
+    fflush(file);
+    EXPECT_EQ(found.accepted, 411);
+    EXPECT_EQ(found.filtered, 10);
+    EXPECT_EQ(found.bytes, static_cast<unsigned long long>(ftell(file)));
+    EXPECT_EQ(found.flushes, 1);
+    EXPECT_EQ(found.errors, 0);
+    EXPECT_EQ(found.dropped, 0);
+    EXPECT_GE(total.accepted, found.accepted);
+
+    unsigned long long timed = 0;
+    for (auto count : found.latency) {
+        timed += count;
+    }
+    EXPECT_GT(timed, 0);
+    EXPECT_LE(timed, found.accepted);
+    EXPECT_LE(found.latency_percentile(0.5), found.latency_percentile(0.99));
+
+    // packets that can't be sent are errors
+    logger::logger_ptr unreachable{new logger::logger{"metrics-syslog",
+            new logger::syslog_sink("metrics-syslog", "logger_tests", logger::log_level::info, logger::syslog::user_facility, 0, "/nonexistent/syslog.sock")}};
+    unreachable->info("lost");
+    EXPECT_EQ(unreachable->metrics().errors, 1);
+    EXPECT_EQ(unreachable->metrics().bytes, 0);
+
+    // decorators and composites add what their sinks did
+    FILE *other = tmpfile();
+    logger::logger_ptr fan_out{new logger::logger{"metrics-composite", new logger::composite_sink(
+            new logger::file_sink("one", "logger_tests", logger::log_level::info, file),
+            new logger::file_sink("two", "logger_tests", logger::log_level::info, other))}};
+    fan_out->info("twice");
+    EXPECT_EQ(fan_out->metrics().accepted, 1);
+    EXPECT_EQ(fan_out->metrics().bytes, 2 * (static_cast<unsigned long long>(ftell(other))));
+
+    logger::registry::instance().remove("metrics");
+    fclose(other);
+    fclose(file);
+}
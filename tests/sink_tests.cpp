@@ -4,6 +4,16 @@
  */
 #include <logger/cpp-logger.hpp>
 #include "gtest/gtest.h"
+#include <thread>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <cstring>
+#include <vector>
 
 TEST(sink, file_sink) {
 
@@ -103,6 +113,1043 @@ TEST(sink, syslog_sink) {
     logger::logger_ptr logger_2 = logger::get<logger::syslog_sink>("syslog");
 }
 
+/** stand-in for syslogd: a datagram socket bound to a temporary path */
+struct syslogd_stub {
+    syslogd_stub() : path("/tmp/syslog-sink-" + std::to_string(getpid()) + ".sock") {
+        unlink(path.c_str());
+        fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address));
+    }
+
+    ~syslogd_stub() {
+        close(fd);
+        unlink(path.c_str());
+    }
+
+    /** @return the packets received so far */
+    std::vector<std::string> receive() {
+        std::vector<std::string> packets;
+        char packet[4096];
+
+        for (ssize_t size = recv(fd, packet, sizeof(packet), MSG_DONTWAIT); size >= 0; size = recv(fd, packet, sizeof(packet), MSG_DONTWAIT)) {
+            packets.emplace_back(packet, static_cast<size_t>(size));
+        }
+        return packets;
+    }
+
+    std::string path;
+    int         fd;
+};
+
+TEST(sink, syslog_sink_rfc5424) {
+    syslogd_stub syslogd;
+
+    logger::syslog_sink sink("rfc5424", "sink_tests", logger::log_level::info, logger::syslog::local1_facility, LOG_PID, syslogd.path);
+    sink.write(logger::log_level::notice, "Hello, %s !", "world");
+
+    auto packets = syslogd.receive();
+    ASSERT_EQ(packets.size(), 1);
+
+    // local1 (17) * 8 + notice (5)
+    EXPECT_EQ(packets[0].find("<141>1 "), 0);
+    EXPECT_NE(packets[0].find(" sink_tests " + std::to_string(getpid()) + " - "), std::string::npos);
+    EXPECT_NE(packets[0].find("[L SUBSYS=rfc5424] Hello, world !"), std::string::npos);
+    EXPECT_NE(packets[0].back(), '\n');
+    EXPECT_EQ(sink.sent(), 1);
+
+    // a forked child sends its own process ID
+    pid_t child = fork();
+    if (child == 0) {
+        sink.write(logger::log_level::notice, "child");
+        _exit(0);
+    }
+    ASSERT_EQ(waitpid(child, nullptr, 0), child);
+
+    packets = syslogd.receive();
+    ASSERT_EQ(packets.size(), 1);
+    EXPECT_NE(packets[0].find(" sink_tests " + std::to_string(child) + " - "), std::string::npos);
+}
+
+TEST(sink, syslog_sink_batch) {
+    syslogd_stub syslogd;
+
+    // user (1) facility, 4 packets per sendmmsg call, no timer
+    logger::syslog_sink sink("batch", "sink_tests", logger::log_level::info, logger::syslog::user_facility, 0, syslogd.path, 4, 0);
+
+    for (auto x = 0; x < 3; x++) {
+        sink.write(logger::log_level::info, "message #%d", x);
+    }
+    EXPECT_EQ(syslogd.receive().size(), 0); // still pending
+
+    sink.write(logger::log_level::info, "message #3");
+    auto packets = syslogd.receive();
+    ASSERT_EQ(packets.size(), 4);
+    EXPECT_NE(packets[0].find("message #0"), std::string::npos);
+    EXPECT_NE(packets[3].find("message #3"), std::string::npos);
+
+    sink.write(logger::log_level::info, "pending");
+    sink.write(logger::log_level::err, "severe messages are sent right away");
+    packets = syslogd.receive();
+    ASSERT_EQ(packets.size(), 2);
+    EXPECT_EQ(packets[1].find("<11>1 "), 0);
+
+    sink.write(logger::log_level::info, "flushed");
+    sink.flush();
+    EXPECT_EQ(syslogd.receive().size(), 1);
+    EXPECT_EQ(sink.sent(), 7);
+    EXPECT_EQ(sink.dropped(), 0);
+}
+
+TEST(sink, syslog_sink_batch_interval) {
+    syslogd_stub syslogd;
+
+    // the batch is never full, the timer sends the pending packet
+    logger::syslog_sink sink("batch-interval", "sink_tests", logger::log_level::info, logger::syslog::user_facility, 0, syslogd.path, 100, 10);
+    sink.write(logger::log_level::info, "pending");
+
+    std::vector<std::string> packets;
+    for (int wait = 0; wait < 100 && packets.empty(); wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        packets = syslogd.receive();
+    }
+
+    ASSERT_EQ(packets.size(), 1);
+    EXPECT_NE(packets[0].find("pending"), std::string::npos);
+    EXPECT_EQ(sink.sent(), 1);
+}
+
+TEST(sink, syslog_sink_batch_interval_fork) {
+    syslogd_stub syslogd;
+
+    auto sink = new logger::syslog_sink("batch-interval", "sink_tests", logger::log_level::info, logger::syslog::user_facility, 0, syslogd.path, 8, 100);
+
+    pid_t child = fork();
+    if (child == 0) {
+        alarm(5); // a child that hangs is killed
+
+        // the child has its own timer
+        sink->write(logger::log_level::info, "sent by the child's timer");
+        for (int wait = 0; wait < 100 && sink->sent() == 0; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int status = sink->sent() == 1 ? 0 : 1;
+
+        delete sink; // joins the child's timer
+        _exit(status);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    auto packets = syslogd.receive();
+    ASSERT_EQ(packets.size(), 1);
+    EXPECT_NE(packets[0].find("sent by the child's timer"), std::string::npos);
+
+    delete sink;
+}
+
+TEST(sink, syslog_sink_unreachable) {
+    logger::syslog_sink sink("unreachable", "sink_tests", logger::log_level::info, logger::syslog::user_facility, 0, "/tmp/no-such-syslogd.sock");
+
+    sink.write(logger::log_level::info, "dropped");
+    EXPECT_EQ(sink.sent(), 0);
+    EXPECT_EQ(sink.dropped(), 1);
+}
+
+TEST(sink, file_sink_large_message) {
+
+    logger::file_sink sink("large", "app", logger::log_level::info, stdout);
+    std::string message(100000, 'x'); // much bigger than the initial buffer, used to blow the stack
+
+    ::testing::internal::CaptureStdout();
+    sink.write(logger::log_level::info, "%s", message.c_str());
+    sink.write(logger::log_level::info, "after %s", "large message");
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    EXPECT_NE(output.find("[L SUBSYS=large] " + message + "\n"), std::string::npos);
+    EXPECT_EQ("[L SUBSYS=large] after large message\n", output.substr(output.rfind("[L SUBSYS")));
+}
+
+/** count the lines of a file */
+unsigned long long count_lines(FILE *file){
+    fflush(file);
+    rewind(file);
+
+    unsigned long long lines = 0;
+    for (int c = fgetc(file); c != EOF; c = fgetc(file)) {
+        lines += (c == '\n') ? 1 : 0;
+    }
+    fseek(file, 0, SEEK_END); // the sink may write again
+
+    return lines;
+}
+
+TEST(sink, file_sink_flush_policy) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::file_sink sink("flush-policy", "app", logger::log_level::info, file, logger::flush_policy(1));
+
+        sink.write(logger::log_level::info, "buffered");
+        EXPECT_EQ(sink.counters().bytes, 0); // still in the sink's buffer
+
+        sink.write(logger::log_level::err, "severe messages are flushed right away");
+        EXPECT_EQ(sink.counters().level, 1);
+        EXPECT_EQ(count_lines(file), 2);
+
+        // 1KB buffer, it must be flushed a few times
+        for (auto x = 0; x < 100; x++) {
+            sink.write(logger::log_level::info, "message #%d", x);
+        }
+        EXPECT_GT(sink.counters().buffer_full, 0);
+
+        sink.flush();
+        EXPECT_EQ(sink.counters().requested, 1);
+        EXPECT_EQ(count_lines(file), 102);
+    }
+    fclose(file);
+}
+
+TEST(sink, file_sink_flush_timer) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::file_sink sink("flush-timer", "app", logger::log_level::info, file, logger::flush_policy(64, 10));
+
+        sink.write(logger::log_level::info, "flushed by the timer");
+
+        for (int wait = 0; wait < 100 && sink.counters().timer == 0; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_GT(sink.counters().timer, 0);
+        EXPECT_EQ(count_lines(file), 1);
+
+        sink.write(logger::log_level::info, "flushed when the sink is destroyed");
+    }
+
+    EXPECT_EQ(count_lines(file), 2);
+    fclose(file);
+}
+
+TEST(sink, file_sink_flush_timer_fork) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    auto sink = new logger::file_sink("flush-timer", "app", logger::log_level::info, file, logger::flush_policy(4, 100));
+
+    pid_t child = fork();
+    if (child == 0) {
+        alarm(5); // a child that hangs is killed
+
+        // the child has its own timer
+        auto flushes = sink->counters().timer;
+        sink->write(logger::log_level::info, "flushed by the child's timer");
+        for (int wait = 0; wait < 100 && sink->counters().timer == flushes; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        int status = sink->counters().timer > flushes ? 0 : 1;
+
+        delete sink; // joins the child's timer
+        _exit(status);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    delete sink;
+    EXPECT_EQ(count_lines(file), 1);
+    fclose(file);
+}
+
+TEST(sink, file_sink_io_backends) {
+    for (auto backend : {logger::io_backend::uring, logger::io_backend::writev}) {
+        FILE *file = tmpfile();
+        ASSERT_NE(file, nullptr);
+        {
+            // 1KB buffers, they must be submitted a few times
+            logger::file_sink sink("io-backend", "app", logger::log_level::info, file, logger::flush_policy(1, 0, logger::log_levels::err, backend));
+
+            // io_uring may not be available, writev is then used
+            EXPECT_NE(sink.backend(), logger::io_backend::stdio);
+            if (backend == logger::io_backend::writev) {
+                EXPECT_EQ(sink.backend(), logger::io_backend::writev);
+            }
+
+            std::vector<std::thread> threads;
+            for (auto t = 0; t < 2; t++) {
+                threads.emplace_back([&sink, t]() {
+                    for (auto x = 0; x < 200; x++) {
+                        sink.write(logger::log_level::info, "thread %d, message #%d", t, x);
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+            EXPECT_GT(sink.counters().buffer_full, 0);
+
+            sink.flush();
+            EXPECT_EQ(count_lines(file), 400);
+
+            sink.write(logger::log_level::err, "severe messages are submitted right away");
+            EXPECT_EQ(sink.counters().level, 1);
+        }
+
+        EXPECT_EQ(count_lines(file), 401);
+        fclose(file);
+    }
+
+    // without buffering, the caller would wait for each io_uring write: writev is used
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::file_sink sink("io-backend", "app", logger::log_level::info, file, logger::flush_policy(0, 0, logger::log_levels::err, logger::io_backend::uring));
+        EXPECT_EQ(sink.backend(), logger::io_backend::writev);
+
+        sink.write(logger::log_level::info, "written right away");
+        EXPECT_EQ(count_lines(file), 1);
+    }
+    fclose(file);
+}
+
+TEST(sink, file_sink_io_backends_metrics) {
+    for (auto backend : {logger::io_backend::uring, logger::io_backend::writev}) {
+        // bytes are counted once written
+        FILE *file = tmpfile();
+        ASSERT_NE(file, nullptr);
+        {
+            logger::file_sink sink("io-backend", "app", logger::log_level::info, file, logger::flush_policy(1, 0, logger::log_levels::err, backend));
+            for (auto x = 0; x < 100; x++) {
+                sink.write(logger::log_level::info, "message #%d", x);
+            }
+            sink.flush();
+
+            EXPECT_EQ(sink.metrics().bytes, static_cast<unsigned long long>(ftell(file)));
+            EXPECT_EQ(sink.metrics().errors, 0);
+        }
+        fclose(file);
+
+        // every write fails (no space left on device)
+        FILE *full = fopen("/dev/full", "w");
+        ASSERT_NE(full, nullptr);
+        {
+            logger::file_sink sink("io-backend", "app", logger::log_level::info, full, logger::flush_policy(1, 0, logger::log_levels::err, backend));
+            for (auto x = 0; x < 100; x++) {
+                sink.write(logger::log_level::info, "message #%d", x);
+            }
+            sink.flush();
+
+            EXPECT_EQ(sink.metrics().bytes, 0);
+            EXPECT_GT(sink.metrics().errors, 0);
+        }
+        fclose(full);
+    }
+}
+
+/** @return the lines of a FILE */
+std::vector<std::string> read_lines(FILE *file) {
+    fflush(file);
+    rewind(file);
+
+    std::vector<std::string> lines;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        lines.emplace_back(line);
+    }
+    fseek(file, 0, SEEK_END);
+
+    return lines;
+}
+
+/** @return the line with its timestamp (second field) replaced by "TIMESTAMP" */
+std::string without_timestamp(const std::string &line) {
+    auto begin = line.find(' ') + 1;
+    auto end = line.find(' ', begin);
+    return line.substr(0, begin) + "TIMESTAMP" + line.substr(end);
+}
+
+/** file sink which program name can be changed */
+class renamed_file_sink : public logger::file_sink {
+public:
+    using logger::file_sink::file_sink;
+    using logger::file_sink::set_program_name;
+};
+
+TEST(sink, file_sink_header) {
+    char hostname[logger::HOST_NAME_MAX] = {0};
+    gethostname(hostname, logger::HOST_NAME_MAX);
+
+    // what the former printf of LOGGER_LOG_PATTERN rendered, with the kernel thread ID (the main thread's is the pid)
+    auto expected = [&hostname](int level, const char *pname, pid_t pid, const char *ecid, const char *text) {
+        char line[1024];
+        snprintf(line, sizeof(line), (std::string(logger::LOGGER_LOG_PATTERN) + "[L SUBSYS=header] %s\n").c_str(),
+                 level, "TIMESTAMP", hostname, pname, pid, pid, ecid, text);
+        return std::string(line);
+    };
+
+    FILE *file = tmpfile();
+    {
+        renamed_file_sink sink("header", "sink_tests", logger::log_level::info, file);
+        sink.write(logger::log_level::info, "no ecid");
+        sink.set_ecid("header-ecid");
+        sink.write(logger::log_level::warning, "ecid");
+        sink.set_program_name("renamed");
+        sink.write(logger::log_level::info, "renamed");
+
+        fflush(file); // or the child writes the FILE's pending lines too
+        pid_t child = fork();
+        if (child == 0) {
+            sink.write(logger::log_level::info, "child");
+            sink.flush();
+            _exit(0);
+        }
+        ASSERT_EQ(waitpid(child, nullptr, 0), child);
+
+        auto lines = read_lines(file);
+        ASSERT_EQ(lines.size(), 4);
+        EXPECT_EQ(without_timestamp(lines[0]), expected(LOG_INFO, "sink_tests", getpid(), "- ", "no ecid"));
+        EXPECT_EQ(without_timestamp(lines[1]), expected(LOG_WARNING, "sink_tests", getpid(), "[M ECID=\"header-ecid\"]", "ecid"));
+        EXPECT_EQ(without_timestamp(lines[2]), expected(LOG_INFO, "renamed", getpid(), "[M ECID=\"header-ecid\"]", "renamed"));
+        EXPECT_EQ(without_timestamp(lines[3]), expected(LOG_INFO, "renamed", child, "[M ECID=\"header-ecid\"]", "child"));
+    }
+    fclose(file);
+}
+
+TEST(sink, thread_info) {
+    const logger::thread_info &main_thread = logger::current_thread();
+    EXPECT_EQ(main_thread.id, syscall(SYS_gettid));
+    EXPECT_EQ(std::string(main_thread.rendered_id, main_thread.rendered_id_size), std::to_string(getpid()));
+
+    FILE *file = tmpfile();
+    long id = 0;
+    std::thread worker([file, &id]() {
+        logger::set_thread_name("worker-with-a-long-name");
+        id = logger::current_thread().id;
+
+        logger::json_file_sink sink("thread", "sink_tests", logger::log_level::info, file);
+        sink.write(logger::log_level::info, "from a named thread");
+    });
+    worker.join();
+
+    EXPECT_NE(id, main_thread.id);
+    EXPECT_EQ(&logger::current_thread(), &main_thread);
+
+    auto lines = read_lines(file);
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_NE(lines[0].find("\"tid\":" + std::to_string(id) + ",\"thread\":\"worker-with-a-l\","), std::string::npos);
+    fclose(file);
+}
+
+TEST(sink, staged_sink) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::staged_sink<logger::file_sink> sink("staged", "app", logger::log_level::info, file);
+
+        // short lived threads: their rings must be merged after they're gone
+        for (auto round = 0; round < 2; round++) {
+            std::vector<std::thread> threads;
+            for (auto t = 0; t < 4; t++) {
+                threads.emplace_back([&sink, t]() {
+                    for (auto x = 0; x < 250; x++) {
+                        sink.write(logger::log_level::info, "thread %d, message #%d", t, x);
+                    }
+                });
+            }
+            for (auto &thread : threads) {
+                thread.join();
+            }
+        }
+
+        sink.flush();
+        EXPECT_EQ(count_lines(file), 2000);
+
+        sink.write(logger::log_level::info, "written when the sink is destroyed");
+    }
+
+    auto lines = read_lines(file);
+    ASSERT_EQ(lines.size(), 2001);
+
+    // each thread's lines are in order
+    int last[4] = {-1, -1, -1, -1};
+    int round[4] = {0, 0, 0, 0};
+    for (size_t index = 0; index < 2000; index++) {
+        auto pos = lines[index].find("thread ");
+        ASSERT_NE(pos, std::string::npos);
+
+        int thread = -1;
+        int message = -1;
+        ASSERT_EQ(sscanf(lines[index].c_str() + pos, "thread %d, message #%d", &thread, &message), 2);
+        if (message < last[thread]) {
+            round[thread]++; // second round
+        }
+        EXPECT_LE(round[thread], 1);
+        last[thread] = message;
+    }
+    fclose(file);
+}
+
+TEST(sink, staged_sink_sequence) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::staged_sink<logger::file_sink, logger::staging_order::sequence> sink(file);
+
+        for (auto x = 0; x < 100; x++) {
+            sink.write(logger::log_level::info, "message #%d", x);
+        }
+    }
+
+    auto lines = read_lines(file);
+    ASSERT_EQ(lines.size(), 100);
+    for (size_t index = 0; index < lines.size(); index++) {
+        EXPECT_NE(lines[index].find("message #" + std::to_string(index) + "\n"), std::string::npos);
+    }
+    fclose(file);
+}
+
+TEST(sink, staged_sink_large_lines) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::staged_sink<logger::file_sink> sink(file);
+
+        // the first line leaves the ring's producer position past the middle, the second one can never be staged
+        sink.write(logger::log_level::info, "%s", std::string(logger::STAGING_RING_SIZE * 6 / 10, 'x').c_str());
+        sink.flush();
+        sink.write(logger::log_level::info, "%s", std::string(logger::STAGING_RING_SIZE * 7 / 10, 'y').c_str());
+    }
+
+    EXPECT_EQ(count_lines(file), 2);
+    EXPECT_GT(static_cast<size_t>(ftell(file)), logger::STAGING_RING_SIZE * 13 / 10);
+    fclose(file);
+}
+
+TEST(sink, staged_sink_sequence_large_lines) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+    {
+        logger::staged_sink<logger::file_sink, logger::staging_order::sequence> sink(file);
+
+        // the first line leaves the ring's producer position past the middle, the large line can't be staged: it must
+        // still be written between the two others
+        sink.write(logger::log_level::info, "%s", std::string(logger::STAGING_RING_SIZE * 6 / 10, 'x').c_str());
+        sink.flush();
+        sink.write(logger::log_level::info, "before");
+        sink.write(logger::log_level::info, "%s", std::string(logger::STAGING_RING_SIZE * 7 / 10, 'y').c_str());
+        sink.write(logger::log_level::info, "after");
+    }
+
+    fflush(file);
+    rewind(file);
+    std::string content;
+    char chunk[4096];
+    for (size_t size = fread(chunk, 1, sizeof(chunk), file); size > 0; size = fread(chunk, 1, sizeof(chunk), file)) {
+        content.append(chunk, size);
+    }
+
+    auto before = content.find("before\n");
+    auto large = content.find("yyyy");
+    auto after = content.find("after\n");
+    ASSERT_NE(before, std::string::npos);
+    ASSERT_NE(large, std::string::npos);
+    ASSERT_NE(after, std::string::npos);
+    EXPECT_LT(before, large);
+    EXPECT_LT(large, after);
+    fclose(file);
+}
+
+TEST(sink, staged_sink_lifetime) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    // a long lived thread that logs into short lived sinks: the rings of the sinks that are gone are forgotten
+    for (auto x = 0; x < 50; x++) {
+        logger::staged_sink<logger::file_sink> sink(file);
+        sink.write(logger::log_level::info, "sink #%d", x);
+    }
+
+    EXPECT_EQ(read_lines(file).size(), 50);
+    fclose(file);
+}
+
+/** count the lines of a file (-1 if it doesn't exist) */
+long count_lines(const std::string &path){
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return -1;
+    }
+
+    long lines = static_cast<long>(count_lines(file));
+    fclose(file);
+
+    return lines;
+}
+
+TEST(sink, file_sink_threads) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    const int threads = 8;
+    const int loop = 2000;
+    const std::string payload { "0123456789abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz end" };
+
+    logger::logger_ptr shared{ new logger::logger{ "shared", new logger::file_sink("shared", "sink_tests", logger::log_level::info, file) } };
+    std::atomic<bool> running{true};
+    std::vector<std::thread> writers;
+
+    // ECIDs keep changing while the lines are written
+    std::thread ecid([&shared, &running]() {
+        for (int x = 0; running.load(); x++) {
+            shared->set_ecid(x % 2 == 0 ? "even" : "odd-0123456789");
+            std::this_thread::yield();
+        }
+    });
+
+    for (int id = 0; id < threads; id++) {
+        writers.emplace_back([&shared, &payload, &file, id]() {
+            // half the threads share a logger, the others get their own one through the registry
+            logger::logger_ptr log = id % 2 == 0 ? shared : logger::get<logger::file_sink>("thread-" + std::to_string(id), file);
+            for (int x = 0; x < loop; x++) {
+                log->info("thread %d line %d %s", id, x, payload.c_str());
+            }
+        });
+    }
+
+    for (auto &writer : writers) {
+        writer.join();
+    }
+    running.store(false);
+    ecid.join();
+
+    auto lines = read_lines(file);
+    EXPECT_EQ(lines.size(), threads * loop);
+
+    std::vector<int> next(threads, 0);
+    for (auto &line : lines) {
+        ASSERT_EQ(line.find("<6>1 "), 0) << line;
+        ASSERT_EQ(line.find("<6>1 ", 1), std::string::npos) << line;
+        ASSERT_EQ(line.size() - line.rfind(payload), payload.size() + 1) << line;
+
+        // each thread's lines are whole and in order
+        int id = -1;
+        int x = -1;
+        ASSERT_EQ(sscanf(line.c_str() + line.find("] thread ") + 2, "thread %d line %d", &id, &x), 2) << line;
+        ASSERT_TRUE(id >= 0 && id < threads) << line;
+        EXPECT_EQ(x, next[id]++);
+    }
+
+    for (int id = 1; id < threads; id += 2) {
+        logger::registry::instance().remove("thread-" + std::to_string(id));
+    }
+    shared.reset();
+    fclose(file);
+}
+
+TEST(sink, rotating_file_sink) {
+    char directory[] = "/tmp/rotating-file-sink-XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    std::string path = std::string(directory) + "/test.log";
+    {
+        // 1KB segments, 2 rotated segments are kept
+        logger::rotating_file_sink sink("rotating", "app", logger::log_level::info, path, logger::rotation_policy(1024, 0, 2));
+
+        for (auto x = 0; x < 100; x++) {
+            sink.write(logger::log_level::info, "message #%d", x);
+
+            // give the background thread a chance to rotate
+            if (x % 10 == 9) {
+                for (int wait = 0; wait < 100 && sink.rotations() < static_cast<unsigned long long>(x / 10); wait++) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        }
+
+        EXPECT_GE(sink.rotations(), 3);
+
+        // let the last requested rotation happen, then write in the active segment
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        sink.write(logger::log_level::info, "last message");
+    }
+
+    EXPECT_GT(count_lines(path), 0);
+    EXPECT_GT(count_lines(path + ".1"), 0);
+    EXPECT_GT(count_lines(path + ".2"), 0);
+    EXPECT_EQ(count_lines(path + ".3"), -1);    // beyond retention
+    EXPECT_EQ(count_lines(path + ".next"), -1); // removed when the sink is destroyed
+
+    for (auto name : {path, path + ".1", path + ".2"}) {
+        unlink(name.c_str());
+    }
+    rmdir(directory);
+}
+
+TEST(sink, rotating_file_sink_on_time) {
+    char directory[] = "/tmp/rotating-file-sink-XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    std::string path = std::string(directory) + "/test.log";
+    {
+        logger::rotating_file_sink sink(path, logger::rotation_policy(0, 1, 1));
+
+        sink.write(logger::log_level::info, "first segment");
+        for (int wait = 0; wait < 300 && sink.rotations() == 0; wait++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        sink.write(logger::log_level::info, "second segment");
+
+        EXPECT_EQ(sink.rotations(), 1);
+    }
+
+    EXPECT_EQ(count_lines(path), 1);
+    EXPECT_EQ(count_lines(path + ".1"), 1);
+
+    for (auto name : {path, path + ".1"}) {
+        unlink(name.c_str());
+    }
+    rmdir(directory);
+}
+
+TEST(sink, rotating_file_sink_stress) {
+    char directory[] = "/tmp/rotating-file-sink-XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    std::string path = std::string(directory) + "/test.log";
+    const unsigned retention = 64;
+    const int writers = 4;
+    const int messages = 20000;
+    {
+        logger::rotating_file_sink sink("rotating", "app", logger::log_level::info, path, logger::rotation_policy(0, 0, retention));
+
+        std::atomic<int> running(writers);
+        std::vector<std::thread> threads;
+        for (auto t = 0; t < writers; t++) {
+            threads.emplace_back([&sink, &running, t]() {
+                for (auto x = 0; x < messages; x++) {
+                    sink.write(logger::log_level::info, "thread %d, message #%d", t, x);
+                }
+                running--;
+            });
+        }
+
+        // rotate as fast as the background thread can while the writers are busy
+        while (running.load() > 0 && sink.rotations() < retention - 1) {
+            auto rotations = sink.rotations();
+            sink.rotate();
+            for (int wait = 0; wait < 1000 && sink.rotations() == rotations; wait++) {
+                std::this_thread::yield();
+            }
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        EXPECT_GT(sink.rotations(), 0);
+    }
+
+    // no line was lost or torn
+    long lines = 0;
+    for (unsigned index = 0; index <= retention; index++) {
+        std::string name = index == 0 ? path : path + "." + std::to_string(index);
+        long count = count_lines(name);
+        if (count > 0) {
+            lines += count;
+        }
+        unlink(name.c_str());
+    }
+    EXPECT_EQ(lines, writers * messages);
+
+    // back-to-back rotations: tiny segments and no retention, the writers keep using segments that are being closed
+    {
+        logger::rotating_file_sink sink("rotating", "app", logger::log_level::info, path, logger::rotation_policy(64, 0, 0));
+
+        std::atomic<int> running(writers);
+        std::vector<std::thread> threads;
+        for (auto t = 0; t < writers; t++) {
+            threads.emplace_back([&sink, &running, t]() {
+                for (auto x = 0; x < messages; x++) {
+                    sink.write(logger::log_level::info, "thread %d, message #%d", t, x);
+                }
+                running--;
+            });
+        }
+
+        while (running.load() > 0) {
+            sink.rotate();
+        }
+
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        EXPECT_GT(sink.rotations(), 0);
+        EXPECT_EQ(sink.metrics().errors, 0);
+    }
+    unlink(path.c_str());
+
+    rmdir(directory);
+}
+
+TEST(sink, mmap_file_sink) {
+    char directory[] = "/tmp/mmap-file-sink-XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    std::string path = std::string(directory) + "/test.log";
+    size_t size = 0;
+    {
+        // tiny windows, so that lines span windows and the background thread has to keep up
+        logger::mmap_file_sink sink("mmap", "app", logger::log_level::info, path, 4096);
+
+        std::vector<std::thread> threads;
+        for (auto t = 0; t < 4; t++) {
+            threads.emplace_back([&sink, t]() {
+                for (auto x = 0; x < 500; x++) {
+                    sink.write(logger::log_level::info, "thread %d, message #%d", t, x);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        sink.sync();
+        size = sink.size();
+    }
+
+    // the unused tail of the last window was truncated
+    struct stat status{};
+    ASSERT_EQ(stat(path.c_str(), &status), 0);
+    EXPECT_EQ(static_cast<size_t>(status.st_size), size);
+    EXPECT_EQ(count_lines(path), 2000);
+
+    // lines are appended, a zeroed tail (left by a crash) is trimmed
+    FILE *file = fopen(path.c_str(), "a");
+    ASSERT_NE(file, nullptr);
+    std::vector<char> zeros(10000, 0);
+    fwrite(zeros.data(), 1, zeros.size(), file);
+    fclose(file);
+    {
+        logger::mmap_file_sink sink(path);
+        EXPECT_EQ(sink.size(), size);
+        sink.write(logger::log_level::info, "after restart");
+    }
+    EXPECT_EQ(count_lines(path), 2001);
+
+    unlink(path.c_str());
+    rmdir(directory);
+}
+
+TEST(sink, json_file_sink) {
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    std::string name { "json"};
+    logger::logger_ptr logger{ new logger::logger{ name, new logger::json_file_sink(name, "shop", logger::log_level::info, file) } };
+
+    logger->info("order %d placed by \"%s\"\n", 42, "acme\tinc");
+    logger->set_ecid("7f3a");
+    logger->warning("stock is low", logger::kv("sku", "A\\B"), logger::kv("left", 3));
+    logger->set_ecid("");
+    logger->set_log_level(logger::log_level::debug, logger::sampling::one_in(4));
+    logger->debug("sampled");
+    logger.reset();
+
+    auto lines = read_lines(file);
+    ASSERT_EQ(lines.size(), 3);
+
+    std::string pid = std::to_string(getpid());
+
+    EXPECT_EQ(lines[0].find("{\"timestamp\":\""), 0);
+    EXPECT_NE(lines[0].find("\",\"level\":\"info\",\"hostname\":\""), std::string::npos);
+    EXPECT_NE(lines[0].find("\",\"program\":\"shop\",\"pid\":" + pid + ",\"tid\":"), std::string::npos);
+    EXPECT_NE(lines[0].find(",\"subsystem\":\"json\",\"ecid\":null,\"message\":\"order 42 placed by \\\"acme\\tinc\\\"\"}\n"), std::string::npos);
+
+    EXPECT_NE(lines[1].find("\"level\":\"warning\""), std::string::npos);
+    EXPECT_NE(lines[1].find(",\"ecid\":\"7f3a\",\"message\":\"stock is low\",\"fields\":{\"sku\":\"A\\\\B\",\"left\":\"3\"}}\n"), std::string::npos);
+
+    EXPECT_NE(lines[2].find(",\"message\":\"sampled\",\"sampling_rate\":0.25}\n"), std::string::npos);
+
+    fclose(file);
+}
+
+TEST(sink, json_stdout_sink) {
+    logger::logger_ptr logger = logger::get<logger::json_stdout_sink>("json-stdout");
+
+    ::testing::internal::CaptureStdout();
+    logger->info("hello from a container");
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    EXPECT_EQ(output.find("{\"timestamp\":"), 0);
+    EXPECT_NE(output.find(",\"subsystem\":\"json-stdout\",\"ecid\":null,\"message\":\"hello from a container\"}\n"), std::string::npos);
+
+    logger::registry::instance().remove("json-stdout");
+}
+
+/** counts how many times it is rendered */
+class counting_message : public logger::message {
+public:
+    void render(logger::buffer &out) const override {
+        renders++;
+        out.append("counted message", 15);
+    }
+
+    mutable int renders = 0;
+};
+
+TEST(sink, composite_sink) {
+    syslogd_stub syslogd;
+    FILE *info = tmpfile();
+    FILE *warning = tmpfile();
+    FILE *json = tmpfile();
+
+    logger::logger_ptr logger = logger::get<logger::composite_sink>("fan-out",
+            new logger::file_sink("info", "sink_tests", logger::log_level::info, info),
+            new logger::json_file_sink("json", "sink_tests", logger::log_level::info, json),
+            new logger::syslog_sink("syslog", "sink_tests", logger::log_level::err, logger::syslog::user_facility, LOG_PID, syslogd.path),
+            new logger::file_sink("warning", "sink_tests", logger::log_level::warning, warning));
+
+    logger->set_ecid("fan-out-ecid");
+    logger->info("hello %s", "info");
+    logger->warning("hello %s", "warning");
+    logger->err("key/value", logger::kv("code", 42));
+
+    auto info_lines = read_lines(info);
+    auto warning_lines = read_lines(warning);
+    auto json_lines = read_lines(json);
+    auto packets = syslogd.receive();
+
+    ASSERT_EQ(info_lines.size(), 3);
+    ASSERT_EQ(warning_lines.size(), 2);
+    ASSERT_EQ(json_lines.size(), 3);
+    ASSERT_EQ(packets.size(), 1);
+
+    // children take the composite's name and ECID, lines that share a layout are the same
+    EXPECT_NE(info_lines[0].find("[M ECID=\"fan-out-ecid\"][L SUBSYS=fan-out] hello info\n"), std::string::npos);
+    EXPECT_EQ(info_lines[1], warning_lines[0]);
+    EXPECT_EQ(info_lines[2], warning_lines[1]);
+    EXPECT_NE(warning_lines[1].find("[L SUBSYS=fan-out] [F code=\"42\"] key/value\n"), std::string::npos);
+    EXPECT_NE(json_lines[2].find("\"subsystem\":\"fan-out\",\"ecid\":\"fan-out-ecid\",\"message\":\"key/value\",\"fields\":{\"code\":\"42\"}}"), std::string::npos);
+    EXPECT_NE(packets[0].find("[L SUBSYS=fan-out] [F code=\"42\"] key/value"), std::string::npos);
+
+    // the message is rendered once
+    auto sink = dynamic_cast<logger::composite_sink *>(new logger::composite_sink(
+            new logger::file_sink("one", "sink_tests", logger::log_level::info, info),
+            new logger::file_sink("two", "sink_tests", logger::log_level::info, warning),
+            new logger::syslog_sink("three", "sink_tests", logger::log_level::info, logger::syslog::user_facility, LOG_PID, syslogd.path)));
+    EXPECT_EQ(sink->size(), 3);
+
+    counting_message msg;
+    sink->emit(logger::log_level::info, msg);
+    EXPECT_EQ(msg.renders, 1);
+    EXPECT_EQ(syslogd.receive().size(), 1);
+    delete sink;
+
+    EXPECT_THROW(logger::composite_sink().add(new logger::composite_sink()), logger::sink_exception);
+
+    logger::registry::instance().remove("fan-out");
+    fclose(info);
+    fclose(warning);
+    fclose(json);
+}
+
+TEST(buffer, append_and_grow) {
+
+    logger::buffer line(8);
+
+    line.append("0123", 4);
+    line.append('4');
+    line.printf("%d%s", 56, "789");
+
+    EXPECT_EQ(line.size(), 10);
+    EXPECT_GE(line.capacity(), 10);
+    EXPECT_STREQ(line.data(), "0123456789");
+    EXPECT_EQ(line.back(), '9');
+
+    line.clear();
+    EXPECT_TRUE(line.empty());
+    EXPECT_STREQ(line.data(), "");
+}
+
+TEST(sink, async_sink) {
+
+    logger::async_sink<logger::stdout_sink> sink("async", "app", logger::log_level::info);
+
+    EXPECT_EQ(sink.level(), logger::log_level::info);
+    EXPECT_EQ(sink.name(), "async");
+    EXPECT_EQ(sink.decorated().name(), "async");
+
+    ::testing::internal::CaptureStdout();
+    sink.write(logger::log_level::debug, "not written, %s", "level is too low");
+    sink.write(logger::log_level::info, "Hello, %s !", "world");
+    sink.flush();
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    auto pos = output.rfind("[L SUBSYS");
+    EXPECT_EQ("[L SUBSYS=async] Hello, world !\n", ( pos != std::string::npos ? output.substr(pos) : "pattern \"[L SUBSYS\" not found"));
+    EXPECT_EQ(output.find("not written"), std::string::npos);
+    EXPECT_EQ(sink.dropped(), 0);
+}
+
+TEST(sink, async_sink_full) {
+
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    unsigned long long dropped = 0;
+    {
+        // a tiny ring, most messages won't fit in it
+        logger::async_sink<logger::file_sink, 4> sink("async-full", "app", logger::log_level::info, file);
+
+        for (auto x = 0; x < 1000; x++) {
+            sink.write(logger::log_level::info, "message #%d", x);
+        }
+        sink.flush();
+
+        dropped = sink.dropped();
+    }
+
+    unsigned long long written = count_lines(file);
+    fclose(file);
+
+    EXPECT_EQ(written + dropped, 1000);
+}
+
+TEST(sink, async_sink_caller_thread) {
+
+    FILE *file = tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    std::string caller;
+    {
+        logger::async_sink<logger::file_sink> sink("async-caller", "app", logger::log_level::info, file);
+
+        // the line carries the caller's thread ID, not the background thread's
+        std::thread([&sink, &caller]() {
+            const logger::thread_info &thread = logger::current_thread();
+            caller.assign(thread.rendered_id, thread.rendered_id_size);
+
+            sink.write(logger::log_level::info, "Hello, world !");
+        }).join();
+        sink.flush();
+
+        // long lines are truncated, but still end the line
+        sink.write(logger::log_level::info, "%s", std::string(2 * logger::ASYNC_SINK_MESSAGE_SIZE, 'x').c_str());
+    }
+
+    auto lines = read_lines(file);
+    fclose(file);
+
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_NE(lines[0].find("." + caller + " - "), std::string::npos);
+    EXPECT_EQ(lines[1].size(), logger::ASYNC_SINK_MESSAGE_SIZE - 1);
+    EXPECT_EQ(lines[1].back(), '\n');
+}
+
 TEST(sink, set_get_ecid) {
 
     logger::stdout_sink sink("stdout", "app", logger::log_level::info);
@@ -117,6 +1164,52 @@ TEST(sink, set_get_ecid) {
     EXPECT_EQ(sink.ecid(), "- ");
 }
 
+TEST(sink, ecid_guard) {
+
+    logger::stdout_sink sink("stdout-ecid-guard", "app", logger::log_level::info);
+    sink.set_ecid("sink-ecid");
+
+    {
+        logger::ecid_guard outer("request-1");
+        EXPECT_EQ(sink.ecid(), "[M ECID=\"request-1\"]");
+
+        {
+            logger::ecid_guard inner("");
+            EXPECT_EQ(sink.ecid(), "- ");
+        }
+        EXPECT_EQ(sink.ecid(), "[M ECID=\"request-1\"]");
+
+        // other threads are not affected
+        std::string other;
+        std::thread([&sink, &other]() { other = sink.ecid(); }).join();
+        EXPECT_EQ(other, "[M ECID=\"sink-ecid\"]");
+
+        ::testing::internal::CaptureStdout();
+        sink.write(logger::log_level::info, "Hello, world !");
+        std::string output = ::testing::internal::GetCapturedStdout();
+        EXPECT_NE(output.find("[M ECID=\"request-1\"][L SUBSYS=stdout-ecid-guard] Hello, world !"), std::string::npos);
+    }
+    EXPECT_EQ(sink.ecid(), "[M ECID=\"sink-ecid\"]");
+
+    // long ECIDs are truncated
+    logger::ecid_guard guard(std::string(logger::MAXECIDLEN + 10, 'x'));
+    EXPECT_EQ(sink.ecid(), "[M ECID=\"" + std::string(logger::MAXECIDLEN, 'x') + "\"]");
+}
+
+TEST(sink, async_sink_ecid_guard) {
+    logger::async_sink<logger::stdout_sink> sink("async-ecid", "app", logger::log_level::info);
+
+    ::testing::internal::CaptureStdout();
+    {
+        logger::ecid_guard guard("request-2");
+        sink.write(logger::log_level::info, "Hello, world !");
+    }
+    sink.flush();
+    std::string output = ::testing::internal::GetCapturedStdout();
+
+    EXPECT_NE(output.find("[M ECID=\"request-2\"][L SUBSYS=async-ecid] Hello, world !"), std::string::npos);
+}
+
 TEST(sink, log_level_name) {
     class test_stdout_sink: public logger::stdout_sink{
     public:
@@ -0,0 +1,49 @@
+//
+//  cpp-logger-decode.cpp
+//
+//  turns binary log files (written by logger::binary_sink) into text.
+//
+//  usage: cpp-logger-decode [binary-log-file]
+//  (the binary log is read from stdin if no file is given)
+//
+
+#include <logger/cpp-logger.hpp>
+#include <cstdio>
+#include <cstring>
+
+int main(int argc, char *argv[]) {
+
+    if (argc > 2 || (argc == 2 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0))) {
+        fprintf(stderr, "usage: %s [binary-log-file]\n", argv[0]);
+        return 2;
+    }
+
+    FILE *input = stdin;
+    if (argc == 2) {
+        input = fopen(argv[1], "rb");
+        if (input == nullptr) {
+            fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+            return 1;
+        }
+    }
+
+    int status = 0;
+
+    try {
+        logger::binary_decoder decoder(input);
+        logger::buffer line;
+
+        while (decoder.next(line)) {
+            fwrite(line.data(), 1, line.size(), stdout);
+        }
+    } catch (logger::logger_exception &err) {
+        fprintf(stderr, "%s: %s\n", argv[0], err.what());
+        status = 1;
+    }
+
+    if (input != stdin) {
+        fclose(input);
+    }
+
+    return status;
+}